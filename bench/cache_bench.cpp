@@ -0,0 +1,85 @@
+/*
+ * Compares cold OBJ loading (read, parse, deduplicate) with warm loading
+ * from the mmaped binary mesh cache.
+ *
+ * usage: cache_bench [faces] [file.obj...]
+ *
+ * Runs on given files and on a synthetic OBJ with given number of faces
+ * (default 2M) written to /tmp. Warm load touches every byte of the mapping,
+ * the same work glBufferData would do.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/mesh_cache.hpp"
+#include "../src/obj.hpp"
+#include "../src/util.hpp"
+#include "synthetic_obj.hpp"
+
+const char SYNTHETIC_PATH[] = "/tmp/cache_bench_synthetic.obj";
+
+template <typename F>
+static double time_ms(F f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static bool bench_file(const char* filename) {
+    remove(mesh_cache_path(filename).c_str());
+
+    size_t cold_bytes = 0;
+    double cold_ms = time_ms([&] {
+        std::string source = load_whole_file(filename);
+        MeshData mesh = parse_obj_format_indexed(source);
+        SourceStamp stamp;
+        get_source_stamp(filename, stamp);
+        write_mesh_cache(mesh_cache_path(filename).c_str(), mesh, stamp,
+                         hash_bytes(source));
+        cold_bytes = mesh.verticies.size() * sizeof(Vertex);
+    });
+
+    bool hit = false;
+    uint32_t checksum = 0;
+    double warm_ms = time_ms([&] {
+        MappedMeshCache cache;
+        hit = open_mesh_cache_for(filename, cache);
+        if (!hit) return;
+        const unsigned char* p = (const unsigned char*)cache.base;
+        for (size_t i = 0; i < cache.size; i += 4) checksum += p[i];
+    });
+
+    std::cout << filename << ": " << cold_bytes / 1024 << " KiB of verticies"
+              << std::endl;
+    std::cout << "  cold (parse + write cache): " << cold_ms << " ms"
+              << std::endl;
+    std::cout << "  warm (mmap cache):          " << warm_ms << " ms ("
+              << cold_ms / warm_ms << "x)" << (hit ? "" : " CACHE MISS")
+              << " [" << checksum << "]" << std::endl;
+    return hit;
+}
+
+int main(int argc, char** argv) {
+    size_t faces = argc > 1 ? strtoull(argv[1], 0, 10) : 2000000;
+    bool ok = true;
+
+    for (int i = 2; i < argc; i++) ok &= bench_file(argv[i]);
+
+    {
+        std::string source = generate_obj(faces);
+        FILE* f = fopen(SYNTHETIC_PATH, "wb");
+        if (!f) return EXIT_FAILURE;
+        fwrite(source.data(), 1, source.size(), f);
+        fclose(f);
+    }
+    ok &= bench_file(SYNTHETIC_PATH);
+    remove(SYNTHETIC_PATH);
+    remove(mesh_cache_path(SYNTHETIC_PATH).c_str());
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
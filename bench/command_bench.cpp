@@ -0,0 +1,255 @@
+/*
+ * Parallel recording of the frame's passes into command buffers against
+ * recording them on the GL thread alone.
+ *
+ * usage: command_bench [objects] [max_threads] [--osmesa]
+ *
+ * Scatters objects cubes (default 50000) with 4 programs around a camera,
+ * turns every one of them each frame and records the 4 shadow cascades and
+ * the camera pass like main() does. Times per frame:
+ *  - prepare() and record() of every pass without a job system
+ *  - the same on a JobSystem of 1 to max_threads threads (default, or 0,
+ *    is the number of cores)
+ *  - replaying all buffers on the GL thread, with the rasterizer
+ *    discarding so only submission is timed
+ * Commands recorded on threads must equal the serially recorded ones.
+ * Runs in a hidden window, or an OSMesa context with --osmesa.
+ */
+#define _ _
+#include <glad/glad.h>
+#define __ __
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../src/arena.hpp"
+#include "../src/frame_data.hpp"
+#include "../src/job_system.hpp"
+#include "../src/lod.hpp"
+#include "../src/mesh.hpp"
+#include "../src/render_queue.hpp"
+#include "../src/shader_manager.hpp"
+#include "../src/shadows.hpp"
+
+const int FRAMES = 30;
+const int PASSES = SHADOW_CASCADES + 1;
+const glm::vec3 SUN_DIRECTION =
+    glm::normalize(glm::vec3{-0.5f, -0.7071f, -0.5f});
+const glm::vec3 Y_AXIS = {0, 1, 0};
+
+struct Scene {
+    std::vector<Mesh> meshes;
+    std::vector<glm::vec3> positions;
+    PassUniforms passes[PASSES];
+};
+
+// every cube turns a little each frame, so prepare() has work to do
+static void move_scene(Scene& scene, int frame) {
+    for (size_t i = 0; i < scene.meshes.size(); i++)
+        scene.meshes[i].model =
+            glm::rotate(glm::translate(glm::mat4(1), scene.positions[i]),
+                        0.01f * frame + i, Y_AXIS);
+}
+
+static void record_frame(Scene& scene, CommandBuffer* buffers,
+                         JobSystem* jobs, double& prepare_ms,
+                         double& record_ms) {
+    auto start = std::chrono::high_resolution_clock::now();
+    frame_arena.reset();
+    RenderQueue queue;
+    for (Mesh& mesh : scene.meshes) queue.push(&mesh);
+    queue.prepare(jobs);
+    auto prepared = std::chrono::high_resolution_clock::now();
+
+    JobCounter recorded;
+    for (int i = 0; i < PASSES; i++)
+        queue.record(scene.passes[i], buffers[i], jobs, &recorded);
+    if (jobs) jobs->wait(recorded);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    prepare_ms +=
+        std::chrono::duration<double, std::milli>(prepared - start).count();
+    record_ms +=
+        std::chrono::duration<double, std::milli>(end - prepared).count();
+}
+
+static bool same_commands(CommandBuffer const& a, CommandBuffer const& b) {
+    if (a.counts != b.counts) return false;
+    for (size_t batch = 0; batch < a.counts.size(); batch++) {
+        for (size_t i = 0; i < a.counts[batch]; i++) {
+            DrawCommand const& x = a.commands[batch * CommandBuffer::BATCH + i];
+            DrawCommand const& y = b.commands[batch * CommandBuffer::BATCH + i];
+            if (x.prog != y.prog || x.vao != y.vao || x.tex0 != y.tex0 ||
+                x.count != y.count || x.first != y.first ||
+                memcmp(&x.model, &y.model, sizeof(x.model)) != 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t count = 50000;
+    unsigned max_threads = 0;
+    bool osmesa = false;
+    int arg = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--osmesa"))
+            osmesa = true;
+        else if (arg++ == 0)
+            count = atoi(argv[i]);
+        else
+            max_threads = atoi(argv[i]);
+    }
+    if (!max_threads)
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (!count) count = 1;
+
+    if (!glfwInit()) {
+        std::cerr << "[ERROR] Failed to init GLFW" << std::endl;
+        return EXIT_FAILURE;
+    }
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    if (osmesa)
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    GLFWwindow* window =
+        glfwCreateWindow(64, 64, "command_bench", NULL, NULL);
+    if (!window) {
+        std::cerr << "[ERROR] Failed to create a window" << std::endl;
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cerr << "[ERROR] Failed to initialize OpenGL context"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+    frame_uniforms.init();
+    shader_manager.init((GLADloadproc)glfwGetProcAddress);
+    GLuint progs[] = {
+        shader_manager.get("shaders/standard.vs", "shaders/uvcolor.fs"),
+        shader_manager.get("shaders/standard.vs", "shaders/gray.fs"),
+        shader_manager.get("shaders/standard.vs",
+                           "shaders/textured_unlit.fs"),
+    };
+    GLuint shadow_prog =
+        shader_manager.get("shaders/shadow.vs", "shaders/shadow.fs");
+    GLuint shadow_instanced_prog =
+        shader_manager.get("shaders/shadow_instanced.vs", "shaders/shadow.fs");
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    Scene scene;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> at(-200, 200), size(0.5f, 2);
+    std::uniform_int_distribution<int> pick(0, 2);
+    scene.meshes.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        scene.positions.push_back({at(rng), 0, at(rng)});
+        scene.meshes.push_back(
+            Mesh::create_cube(glm::vec3(0), size(rng), progs[pick(rng)]));
+    }
+
+    // camera in the middle, cascades follow it like in main()
+    glm::mat4 view = glm::lookAt(glm::vec3(0, 5, 0), glm::vec3(0, 5, -1),
+                                 Y_AXIS);
+    glm::mat4 projection = glm::perspective(45.f, 1.5f, 0.01f, 1000.f);
+    ShadowCascades shadows;
+    shadows.init(256, 60);
+    shadows.update(view, projection, SUN_DIRECTION);
+    lod_view.set(glm::vec3(0, 5, 0), projection);
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        PassUniforms& pass = scene.passes[i];
+        pass = {};
+        pass.projection = shadows.projections[i];
+        pass.view = shadows.views[i];
+        pass.depth_prog = shadow_prog;
+        pass.depth_instanced_prog = shadow_instanced_prog;
+        pass.lod_bias = 1;
+    }
+    PassUniforms& camera = scene.passes[SHADOW_CASCADES];
+    camera = {};
+    camera.projection = projection;
+    camera.view = view;
+    camera.shadows = &shadows;
+    std::cout << count << " objects, " << PASSES << " passes" << std::endl;
+
+    // the GL thread on its own, as before the job system
+    CommandBuffer reference[PASSES];
+    double prepare_ms = 0, record_ms = 0;
+    for (int frame = 0; frame < FRAMES; frame++) {
+        move_scene(scene, frame);
+        record_frame(scene, reference, 0, prepare_ms, record_ms);
+    }
+    double serial_ms = (prepare_ms + record_ms) / FRAMES;
+    std::cout << "no jobs: " << serial_ms << " ms (prepare "
+              << prepare_ms / FRAMES << " ms, record " << record_ms / FRAMES
+              << " ms)" << std::endl;
+
+    // submission alone, what is left on the GL thread
+    glFinish();
+    auto start = std::chrono::high_resolution_clock::now();
+    render_stats.reset();
+    CullStats camera_cull = {};
+    for (int frame = 0; frame < FRAMES; frame++) {
+        frame_uniforms.begin_frame();
+        for (int i = 0; i < PASSES; i++) camera_cull = reference[i].replay();
+        frame_uniforms.end_frame();
+    }
+    glFinish();
+    double replay_ms = std::chrono::duration<double, std::milli>(
+                           std::chrono::high_resolution_clock::now() - start)
+                           .count() /
+                       FRAMES;
+    std::cout << "replay: " << replay_ms << " ms for "
+              << render_stats.draw_calls / FRAMES << " draws, camera sees "
+              << camera_cull.visible << std::endl;
+
+    move_scene(scene, FRAMES);
+    record_frame(scene, reference, 0, prepare_ms, record_ms);
+    bool same = true;
+
+    CommandBuffer buffers[PASSES];
+    double one_thread_ms = 0;
+    for (unsigned threads = 1; threads <= max_threads; threads++) {
+        JobSystem jobs(threads);
+        prepare_ms = record_ms = 0;
+        for (int frame = 0; frame < FRAMES; frame++) {
+            move_scene(scene, frame);
+            record_frame(scene, buffers, &jobs, prepare_ms, record_ms);
+        }
+        double ms = (prepare_ms + record_ms) / FRAMES;
+        if (threads == 1) one_thread_ms = ms;
+        std::cout << threads << " threads: " << ms << " ms (prepare "
+                  << prepare_ms / FRAMES << " ms, record "
+                  << record_ms / FRAMES << " ms, " << one_thread_ms / ms
+                  << "x, " << serial_ms / ms << "x no jobs, " << jobs.steals
+                  << " steals)" << std::endl;
+
+        move_scene(scene, FRAMES);
+        record_frame(scene, buffers, &jobs, prepare_ms, record_ms);
+        for (int i = 0; i < PASSES; i++)
+            same &= same_commands(buffers[i], reference[i]);
+    }
+    std::cout << "commands " << (same ? "match" : "DIFFER") << std::endl;
+
+    scene.meshes.clear();
+    shadows.destroy();
+    frame_uniforms.destroy();
+    shader_manager.destroy();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
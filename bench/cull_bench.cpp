@@ -0,0 +1,95 @@
+/*
+ * Times frustum culling of many bounding spheres with cull_spheres over
+ * separate coordinate arrays against a plain loop over an array of spheres.
+ *
+ * usage: cull_bench [objects]
+ *
+ * Spheres are scattered in a 200 unit cube around a camera looking down -z
+ * with the player camera projection (default 10000 objects).
+ */
+#include <chrono>
+#include <cstdlib>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../src/culling.hpp"
+
+const int REPEATS = 100;
+
+struct Sphere {
+    glm::vec3 center;
+    float radius;
+};
+
+template <typename F>
+static double time_us(F f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < REPEATS; i++) f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() /
+           REPEATS;
+}
+
+// reference, one sphere at a time with early out
+static unsigned cull_aos(std::vector<Sphere> const& spheres,
+                         Frustum const& frustum) {
+    unsigned visible = 0;
+    for (Sphere const& s : spheres) {
+        bool inside = true;
+        for (glm::vec4 const& p : frustum.planes) {
+            if (glm::dot(glm::vec3(p), s.center) + p.w < -s.radius) {
+                inside = false;
+                break;
+            }
+        }
+        visible += inside;
+    }
+    return visible;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? atol(argv[1]) : 10000;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> pos(-100, 100), rad(0.1f, 2);
+
+    std::vector<Sphere> spheres(count);
+    std::vector<float> x(count), y(count), z(count), radius(count);
+    std::vector<uint8_t> visible(count);
+    for (size_t i = 0; i < count; i++) {
+        Sphere& s = spheres[i];
+        s = {{pos(rng), pos(rng), pos(rng)}, rad(rng)};
+        x[i] = s.center.x;
+        y[i] = s.center.y;
+        z[i] = s.center.z;
+        radius[i] = s.radius;
+    }
+
+    glm::mat4 projection =
+        glm::perspective(45.f, 1200.f / 800.f, 0.01f, 1000.f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0), {0, 0, -1}, {0, 1, 0});
+    Frustum frustum = extract_frustum(projection * view);
+
+    unsigned aos_visible = 0;
+    CullStats stats = {};
+    double aos_us = time_us([&] { aos_visible = cull_aos(spheres, frustum); });
+    double soa_us = time_us([&] {
+        stats = cull_spheres(frustum, x.data(), y.data(), z.data(),
+                             radius.data(), count, visible.data());
+    });
+
+    std::cout << count << " spheres, " << stats.visible << " visible, "
+              << stats.culled << " culled" << std::endl;
+    std::cout << "  array of spheres: " << aos_us << " us" << std::endl;
+    std::cout << "  cull_spheres:     " << soa_us << " us ("
+              << aos_us / soa_us << "x)" << std::endl;
+
+    if (aos_visible != stats.visible) {
+        std::cerr << "[ERROR] Visible counts differ: " << aos_visible
+                  << " vs " << stats.visible << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
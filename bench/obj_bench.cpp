@@ -0,0 +1,141 @@
+/*
+ * Compares the string_view OBJ parser with the old stringstream one.
+ *
+ * usage: obj_bench [faces] [file.obj...]
+ *
+ * Generates a synthetic OBJ with given number of faces (default 2M), times
+ * both parsers on it and checks that their output is byte-identical. Any
+ * extra files (e.g. the .obj files under assets/) are only checked for
+ * identical output.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/obj.hpp"
+#include "../src/util.hpp"
+#include "synthetic_obj.hpp"
+
+// parser as it was before the rewrite, kept here as reference
+static std::vector<Vertex> parse_obj_format_stringstream(
+    std::string const& input) {
+    std::stringstream iss(input);
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texcoords;
+    std::vector<Vertex> output;
+    int ln = 0;
+    while (!iss.eof()) {
+        ln++;
+        std::string line;
+        std::getline(iss, line);
+        if (line.size() == 0 || line[0] == '#') continue;
+
+        std::stringstream lss(line);
+        std::string command;
+        lss >> command;
+        if (command.size() == 0) continue;
+
+        if (command == "v") {
+            glm::vec3 v;
+            lss >> v.x >> v.y >> v.z;
+            positions.push_back(v);
+        } else if (command == "vn") {
+            glm::vec3 n;
+            lss >> n.x >> n.y >> n.z;
+            normals.push_back(n);
+        } else if (command == "vt") {
+            glm::vec2 tc;
+            lss >> tc.x >> tc.y;
+            texcoords.push_back(tc);
+        } else if (command == "f") {
+            for (int i = 0; i < 3; i++) {
+                std::string vertex_index;
+                std::vector<int> indicies;
+                lss >> vertex_index;
+                int acc = 0;
+                int sig = 1;
+                for (size_t j = 0; j <= vertex_index.size(); j++) {
+                    if (j == vertex_index.size() || vertex_index[j] == '/') {
+                        indicies.push_back(acc * sig);
+                        acc = 0;
+                        sig = 1;
+                    } else if (vertex_index[j] == '-') {
+                        sig *= -1;
+                    } else if (std::isdigit(vertex_index[j])) {
+                        acc = acc * 10 + (vertex_index[j] - '0');
+                    }
+                }
+
+                int pi, ti, ni;
+                pi = indicies[0];
+                ti = (indicies.size() > 1) ? indicies[1] : 0;
+                ni = (indicies.size() > 2) ? indicies[2] : 0;
+
+                Vertex result = {};
+                if (pi > 0) result.position = positions[pi - 1];
+                if (pi < 0) result.position = positions[positions.size() + pi];
+                if (ti > 0) result.texture_coord = texcoords[ti - 1];
+                if (ti < 0)
+                    result.texture_coord = texcoords[texcoords.size() + ti];
+                if (ni > 0) result.normal = normals[ni - 1];
+                if (ni < 0) result.normal = normals[normals.size() + ni];
+
+                output.push_back(result);
+            }
+        }
+    }
+
+    return output;
+}
+
+static bool same_output(std::vector<Vertex> const& a,
+                        std::vector<Vertex> const& b) {
+    return a.size() == b.size() &&
+           memcmp(a.data(), b.data(), a.size() * sizeof(Vertex)) == 0;
+}
+
+template <typename F>
+static double time_ms(F f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t faces = argc > 1 ? strtoull(argv[1], 0, 10) : 2000000;
+    bool ok = true;
+
+    for (int i = 2; i < argc; i++) {
+        std::string src = load_whole_file(argv[i]);
+        bool same = same_output(parse_obj_format_stringstream(src),
+                                parse_obj_format(src));
+        std::cout << argv[i] << ": " << (same ? "identical" : "DIFFERENT")
+                  << std::endl;
+        ok &= same;
+    }
+
+    std::string src = generate_obj(faces);
+    std::cout << "synthetic OBJ: " << faces << " faces, "
+              << src.size() / (1024 * 1024) << " MiB" << std::endl;
+
+    std::vector<Vertex> old_out, new_out;
+    double old_ms =
+        time_ms([&] { old_out = parse_obj_format_stringstream(src); });
+    double new_ms = time_ms([&] { new_out = parse_obj_format(src); });
+
+    bool same = same_output(old_out, new_out);
+    ok &= same;
+
+    std::cout << "stringstream: " << old_ms << " ms" << std::endl;
+    std::cout << "string_view:  " << new_ms << " ms (" << old_ms / new_ms
+              << "x)" << std::endl;
+    std::cout << "output: " << (same ? "identical" : "DIFFERENT") << std::endl;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,76 @@
+/*
+ * Scaling of the parallel OBJ parser over thread counts.
+ *
+ * usage: obj_parallel_bench [faces] [max_threads] [file.obj...]
+ *
+ * Generates a synthetic OBJ with given number of faces (default 8M) and
+ * times parse_obj_format_parallel with 1 to max_threads workers (default,
+ * or 0, is the number of cores) against the serial parser. Every run and
+ * every extra file must give output identical to parse_obj_format.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/obj.hpp"
+#include "../src/thread_pool.hpp"
+#include "../src/util.hpp"
+#include "synthetic_obj.hpp"
+
+static bool same_output(std::vector<Vertex> const& a,
+                        std::vector<Vertex> const& b) {
+    return a.size() == b.size() &&
+           memcmp(a.data(), b.data(), a.size() * sizeof(Vertex)) == 0;
+}
+
+template <typename F>
+static double time_ms(F f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t faces = argc > 1 ? strtoull(argv[1], 0, 10) : 8000000;
+    unsigned max_threads = argc > 2 ? atoi(argv[2]) : 0;
+    if (!max_threads)
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+    bool ok = true;
+
+    for (int i = 3; i < argc; i++) {
+        std::string src = load_whole_file(argv[i]);
+        ThreadPool pool(max_threads);
+        bool same = same_output(parse_obj_format(src),
+                                parse_obj_format_parallel(src, pool));
+        std::cout << argv[i] << ": " << (same ? "identical" : "DIFFERENT")
+                  << std::endl;
+        ok &= same;
+    }
+
+    std::string src = generate_obj(faces);
+    std::cout << "synthetic OBJ: " << faces << " faces, "
+              << src.size() / (1024 * 1024) << " MiB" << std::endl;
+
+    std::vector<Vertex> serial_out;
+    double serial_ms = time_ms([&] { serial_out = parse_obj_format(src); });
+    std::cout << "serial:     " << serial_ms << " ms" << std::endl;
+
+    for (unsigned threads = 1; threads <= max_threads; threads++) {
+        ThreadPool pool(threads);
+        std::vector<Vertex> out;
+        double ms =
+            time_ms([&] { out = parse_obj_format_parallel(src, pool); });
+        bool same = same_output(serial_out, out);
+        ok &= same;
+        std::cout << threads << " threads:  " << ms << " ms ("
+                  << serial_ms / ms << "x)"
+                  << (same ? "" : " DIFFERENT") << std::endl;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
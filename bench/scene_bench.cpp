@@ -0,0 +1,154 @@
+/*
+ * Transform updates of a SceneGraph against composing every matrix by hand
+ * each frame, the way main() used to.
+ *
+ * usage: scene_bench [nodes] [max_threads]
+ *
+ * Builds trees of 10 nodes (a root, 3 children with 2 children each) up to
+ * the node count (default 100000) and times per frame:
+ *  - the hand composed baseline, translate/rotate/scale chains and a full
+ *    inverse for every node
+ *  - update() with every root moved, 1% of the roots moved and nothing
+ *    moved
+ *  - update() with every root moved on 1 to max_threads threads (default,
+ *    or 0, is the number of cores)
+ * Threaded and partial updates must give the same matrices as a serial
+ * update of everything.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../src/scene_graph.hpp"
+#include "../src/thread_pool.hpp"
+
+const int FRAMES = 20;
+const glm::vec3 Y_AXIS = {0, 1, 0};
+
+template <typename F>
+static double ms_per_frame(F f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) f(frame);
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() /
+           FRAMES;
+}
+
+static bool same_matrices(SceneGraph const& a, SceneGraph const& b) {
+    return memcmp(a.world.data(), b.world.data(),
+                  a.world.size() * sizeof(glm::mat4)) == 0 &&
+           memcmp(a.normal.data(), b.normal.data(),
+                  a.normal.size() * sizeof(glm::mat3)) == 0;
+}
+
+// trees of a root, 3 children and 6 grandchildren, added depth first
+static void build_forest(SceneGraph& scene, size_t nodes,
+                         std::vector<uint32_t>& roots) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> at(-100, 100), angle(0, 6.28f);
+    while (scene.size() + 10 <= nodes) {
+        uint32_t root = scene.add();
+        roots.push_back(root);
+        scene.set_position(root, {at(rng), 0, at(rng)});
+        for (int i = 0; i < 3; i++) {
+            uint32_t child = scene.add(root);
+            scene.set_local(child, {1.f + i, 0.5f, 0},
+                            glm::angleAxis(angle(rng), Y_AXIS),
+                            glm::vec3(0.5f));
+            for (int j = 0; j < 2; j++) {
+                uint32_t leaf = scene.add(child);
+                scene.set_position(leaf, {0, 0.25f + j, 0.5f});
+            }
+        }
+    }
+}
+
+static void move_roots(SceneGraph& scene, std::vector<uint32_t> const& roots,
+                       int frame, size_t step) {
+    for (size_t i = 0; i < roots.size(); i += step)
+        scene.set_rotation(roots[i], glm::angleAxis(0.01f * frame, Y_AXIS));
+}
+
+int main(int argc, char** argv) {
+    size_t nodes = argc > 1 ? atoi(argv[1]) : 100000;
+    unsigned max_threads = argc > 2 ? atoi(argv[2]) : 0;
+    if (!max_threads)
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (nodes < 10) nodes = 10;
+
+    SceneGraph scene;
+    std::vector<uint32_t> roots;
+    build_forest(scene, nodes, roots);
+    scene.update();
+    std::cout << scene.size() << " nodes, " << roots.size() << " trees"
+              << std::endl;
+
+    // baseline, every matrix composed and inverted every frame
+    std::vector<float> angles(scene.size());
+    for (size_t node = 0; node < scene.size(); node++)
+        angles[node] = 2 * std::acos(std::min(scene.rotation[node].w, 1.f));
+    std::vector<glm::mat4> world(scene.size());
+    std::vector<glm::mat3> normal(scene.size());
+    double naive_ms = ms_per_frame([&](int frame) {
+        for (uint32_t root : roots) angles[root] = 0.01f * frame;
+        for (size_t node = 0; node < scene.size(); node++) {
+            glm::mat4 m = glm::translate(glm::mat4(1), scene.position[node]);
+            m = glm::rotate(m, angles[node], Y_AXIS);
+            m = glm::scale(m, scene.scale[node]);
+            uint32_t parent = scene.parent[node];
+            world[node] = parent == NO_PARENT ? m : world[parent] * m;
+            normal[node] = glm::transpose(glm::inverse(world[node]));
+        }
+    });
+    std::cout << "hand composed: " << naive_ms << " ms" << std::endl;
+
+    double all_ms = ms_per_frame([&](int frame) {
+        move_roots(scene, roots, frame, 1);
+        scene.update();
+    });
+    std::cout << "all moved: " << all_ms << " ms (" << scene.updated
+              << " nodes, " << naive_ms / all_ms << "x)" << std::endl;
+
+    double some_ms = ms_per_frame([&](int frame) {
+        move_roots(scene, roots, frame, 100);
+        scene.update();
+    });
+    std::cout << "1% moved: " << some_ms << " ms (" << scene.updated
+              << " nodes)" << std::endl;
+
+    double none_ms = ms_per_frame([&](int frame) { scene.update(); });
+    std::cout << "nothing moved: " << none_ms << " ms" << std::endl;
+
+    // everything recomputed serially is the reference
+    move_roots(scene, roots, FRAMES, 1);
+    SceneGraph reference = scene;
+    for (uint8_t& dirty : reference.dirty) dirty = 1;
+    reference.update();
+    bool same = true;
+
+    double serial_ms = 0;
+    for (unsigned threads = 1; threads <= max_threads; threads++) {
+        // the caller works too, so the pool has one thread less
+        ThreadPool pool(threads > 1 ? threads - 1 : 1);
+        ThreadPool* used = threads > 1 ? &pool : 0;
+        double ms = ms_per_frame([&](int frame) {
+            move_roots(scene, roots, frame, 1);
+            scene.update(used);
+        });
+        if (threads == 1) serial_ms = ms;
+        std::cout << threads << " threads: " << ms << " ms ("
+                  << serial_ms / ms << "x)" << std::endl;
+
+        move_roots(scene, roots, FRAMES, 1);
+        scene.update(used);
+        same &= same_matrices(scene, reference);
+    }
+
+    std::cout << "matrices " << (same ? "match" : "DIFFER") << std::endl;
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
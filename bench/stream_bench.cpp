@@ -0,0 +1,189 @@
+/*
+ * Streaming throughput of per frame geometry.
+ *
+ * usage: stream_bench [verticies_per_pass] [--osmesa]
+ *
+ * Every frame streams 4 passes of verticies_per_pass triangle verticies
+ * (default 30000) and draws them with the rasterizer discarding, so only
+ * the upload and vertex fetch are timed:
+ *  - StreamBuffer, the fenced ring written through unsynchronized maps
+ *  - glBufferSubData into one buffer, which may wait for earlier draws
+ *  - a new buffer and VAO for every pass, like recreating a Mesh
+ * Runs in a hidden window, or an OSMesa context with --osmesa.
+ */
+#define _ _
+#include <glad/glad.h>
+#define __ __
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../src/frame_data.hpp"
+#include "../src/shader_manager.hpp"
+#include "../src/stream_buffer.hpp"
+
+const int FRAMES = 300;
+const int PASSES = 4;
+
+static void bind_layout() {
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(StreamVertex),
+                          (void*)offsetof(StreamVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(StreamVertex),
+                          (void*)offsetof(StreamVertex, color));
+}
+
+// runs FRAMES frames of pass(), returns million verticies per second
+static double run(const char* name, size_t verticies_per_pass,
+                  std::function<void()> begin_frame,
+                  std::function<void()> pass,
+                  std::function<void()> end_frame) {
+    glFinish();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        begin_frame();
+        for (int i = 0; i < PASSES; i++) pass();
+        end_frame();
+        glFlush();
+    }
+    glFinish();
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double rate = FRAMES * PASSES * verticies_per_pass / seconds / 1e6;
+    std::cout << name << ": " << rate << " M verticies per second, "
+              << seconds * 1000 / FRAMES << " ms per frame" << std::endl;
+    return rate;
+}
+
+int main(int argc, char** argv) {
+    size_t count = 30000;
+    bool osmesa = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--osmesa"))
+            osmesa = true;
+        else
+            count = atoi(argv[i]);
+    }
+    count = count / 3 * 3;
+    if (!count) count = 3;
+
+    if (!glfwInit()) {
+        std::cerr << "[ERROR] Failed to init GLFW" << std::endl;
+        return EXIT_FAILURE;
+    }
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    if (osmesa)
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "stream_bench", NULL, NULL);
+    if (!window) {
+        std::cerr << "[ERROR] Failed to create a window" << std::endl;
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cerr << "[ERROR] Failed to initialize OpenGL context"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+    frame_uniforms.init();
+    shader_manager.init((GLADloadproc)glfwGetProcAddress);
+    GLuint prog = shader_manager.get("shaders/stream.vs", "shaders/stream.fs");
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    // new verticies every pass, as a CPU side generator would make them
+    std::vector<StreamVertex> verticies(count);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> at(-1, 1);
+    for (StreamVertex& v : verticies)
+        v = {{at(rng), at(rng), at(rng)}, pack_rgba(255, 255, 255)};
+    size_t bytes = count * sizeof(StreamVertex);
+
+    FrameData identity = {};
+    identity.view = identity.projection = glm::mat4(1);
+    auto frame_begin = [&] {
+        frame_uniforms.begin_frame();
+        frame_uniforms.write(identity);
+    };
+
+    StreamBuffer ring;
+    ring.init(prog, count * PASSES);
+    unsigned orphans = 0;
+    double ring_rate = run(
+        "ring", count,
+        [&] {
+            frame_begin();
+            ring.begin_frame();
+        },
+        [&] {
+            ring.push_triangles(verticies.data(), count);
+            ring.flush();
+        },
+        [&] {
+            orphans += ring.orphans;
+            ring.end_frame();
+            frame_uniforms.end_frame();
+        });
+    ring.destroy();
+
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, bytes, 0, GL_DYNAMIC_DRAW);
+    bind_layout();
+    double subdata_rate = run(
+        "glBufferSubData", count, frame_begin,
+        [&] {
+            glUseProgram(prog);
+            glBindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, verticies.data());
+            glDrawArrays(GL_TRIANGLES, 0, count);
+        },
+        [&] { frame_uniforms.end_frame(); });
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+
+    double recreate_rate = run(
+        "recreate", count, frame_begin,
+        [&] {
+            GLuint mesh_vao, mesh_vbo;
+            glGenVertexArrays(1, &mesh_vao);
+            glBindVertexArray(mesh_vao);
+            glGenBuffers(1, &mesh_vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, mesh_vbo);
+            glBufferData(GL_ARRAY_BUFFER, bytes, verticies.data(),
+                         GL_STATIC_DRAW);
+            bind_layout();
+            glUseProgram(prog);
+            glDrawArrays(GL_TRIANGLES, 0, count);
+            glDeleteBuffers(1, &mesh_vbo);
+            glDeleteVertexArrays(1, &mesh_vao);
+        },
+        [&] { frame_uniforms.end_frame(); });
+
+    std::cout << "ring is " << ring_rate / subdata_rate
+              << "x glBufferSubData, " << ring_rate / recreate_rate
+              << "x recreate (" << orphans << " orphans)" << std::endl;
+
+    frame_uniforms.destroy();
+    shader_manager.destroy();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,52 @@
+#ifndef __SYNTHETIC_OBJ_HPP
+#define __SYNTHETIC_OBJ_HPP
+
+#include <cstdio>
+#include <string>
+
+// grid of quads with shared positions, mixes absolute and relative indicies
+inline std::string generate_obj(size_t faces) {
+    size_t quads = (faces + 1) / 2;
+    size_t side = 1;
+    while (side * side < quads) side++;
+
+    std::string out;
+    out.reserve(quads * 120);
+    char buff[128];
+
+    out += "# synthetic\nvn 0 1 0\nvn 0 -1 0\n";
+    for (int i = 0; i < 256; i++) {
+        snprintf(buff, sizeof(buff), "vt %f 0.5\n", (i + 0.5f) / 256);
+        out += buff;
+    }
+    for (size_t z = 0; z <= side; z++) {
+        for (size_t x = 0; x <= side; x++) {
+            snprintf(buff, sizeof(buff), "v %.1f %.4f %.1f\n", x * 0.1f,
+                     (float)((x * 7 + z * 13) % 100) / 1000, z * 0.1f);
+            out += buff;
+        }
+    }
+    size_t emitted = 0;
+    for (size_t z = 0; z < side && emitted < faces; z++) {
+        for (size_t x = 0; x < side && emitted < faces; x++) {
+            size_t a = z * (side + 1) + x + 1;
+            size_t b = a + 1;
+            size_t c = a + side + 1;
+            size_t d = c + 1;
+            int t = (x + z) % 256 + 1;
+            snprintf(buff, sizeof(buff), "f %zu/%d/1 %zu/%d/1 %zu/%d/1\n", a,
+                     t, c, t, b, t);
+            out += buff;
+            emitted++;
+            if (emitted < faces) {
+                snprintf(buff, sizeof(buff), "f %zu/%d/-2 %zu//-2 %zu/-1/1\n",
+                         b, t, c, d);
+                out += buff;
+                emitted++;
+            }
+        }
+    }
+    return out;
+}
+
+#endif  // __SYNTHETIC_OBJ_HPP
@@ -0,0 +1,107 @@
+/*
+ * Compares greedy meshed VOX models with their MagicaVoxel OBJ exports.
+ *
+ * usage: vox_bench [name...]   (default: wand shotgun)
+ *
+ * For each assets/<name>.vox checks that the surface area per face direction
+ * and the bounding box size match assets/<name>.obj, then prints triangle
+ * counts and load times of both paths. Scene transforms (nTRN) are ignored
+ * by the VOX loader, so the position may be off by a voxel.
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../src/obj.hpp"
+#include "../src/util.hpp"
+#include "../src/vox.hpp"
+
+const int ITERATIONS = 1000;
+
+struct SurfaceStats {
+    float area[6];  // per axis direction: +x, -x, +y, -y, +z, -z
+    glm::vec3 min, max;
+};
+
+static SurfaceStats surface_stats(MeshData const& mesh) {
+    SurfaceStats stats = {};
+    stats.min = glm::vec3(1e9f);
+    stats.max = glm::vec3(-1e9f);
+    for (size_t i = 0; i < mesh.indicies.size(); i += 3) {
+        Vertex const& a = mesh.verticies[mesh.indicies[i]];
+        Vertex const& b = mesh.verticies[mesh.indicies[i + 1]];
+        Vertex const& c = mesh.verticies[mesh.indicies[i + 2]];
+        glm::vec3 n = a.normal;
+        int axis = std::fabs(n.x) > 0.5f ? 0 : std::fabs(n.y) > 0.5f ? 1 : 2;
+        int dir = n[axis] > 0 ? 0 : 1;
+        stats.area[axis * 2 + dir] +=
+            glm::length(glm::cross(b.position - a.position,
+                                   c.position - a.position)) *
+            0.5f;
+        for (Vertex const* v : {&a, &b, &c}) {
+            stats.min = glm::min(stats.min, v->position);
+            stats.max = glm::max(stats.max, v->position);
+        }
+    }
+    return stats;
+}
+
+template <typename F>
+static double time_us(F f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() /
+           ITERATIONS;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; i++) names.push_back(argv[i]);
+    if (names.empty()) names = {"wand", "shotgun"};
+
+    bool ok = true;
+    for (std::string const& name : names) {
+        std::string obj_path = "assets/" + name + ".obj";
+        std::string vox_path = "assets/" + name + ".vox";
+        std::string obj_src = load_whole_file(obj_path.c_str());
+        std::string vox_src = load_whole_file(vox_path.c_str());
+
+        MeshData obj_mesh = parse_obj_format_indexed(obj_src);
+        VoxModel model;
+        if (!parse_vox_format(vox_src, model)) return EXIT_FAILURE;
+        MeshData vox_mesh = greedy_mesh_voxels(model);
+
+        SurfaceStats obj_stats = surface_stats(obj_mesh);
+        SurfaceStats vox_stats = surface_stats(vox_mesh);
+
+        glm::vec3 obj_extent = obj_stats.max - obj_stats.min;
+        glm::vec3 vox_extent = vox_stats.max - vox_stats.min;
+        bool same = glm::length(obj_extent - vox_extent) < 1e-4f;
+        for (int i = 0; i < 6; i++)
+            same &= std::fabs(obj_stats.area[i] - vox_stats.area[i]) < 1e-3f;
+        ok &= same;
+
+        double obj_us = time_us([&] { parse_obj_format_indexed(obj_src); });
+        double vox_us = time_us([&] {
+            VoxModel m;
+            parse_vox_format(vox_src, m);
+            greedy_mesh_voxels(m);
+        });
+
+        float area = 0;
+        for (float a : vox_stats.area) area += a;
+        std::cout << name << ": surface " << (same ? "matches" : "DIFFERS")
+                  << " (area " << area << ")" << std::endl;
+        std::cout << "  obj: " << obj_mesh.indicies.size() / 3
+                  << " triangles, " << obj_mesh.verticies.size()
+                  << " verticies, " << obj_us << " us" << std::endl;
+        std::cout << "  vox: " << vox_mesh.indicies.size() / 3
+                  << " triangles, " << vox_mesh.verticies.size()
+                  << " verticies, " << vox_us << " us" << std::endl;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
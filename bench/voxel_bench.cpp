@@ -0,0 +1,167 @@
+/*
+ * Edit and remesh throughput of the chunked VoxelWorld.
+ *
+ * usage: voxel_bench [chunks_per_side] [max_threads]
+ *
+ * Generates terrain of chunks_per_side x 2 x chunks_per_side chunks
+ * (default 8) and times:
+ *  - single cell edits, which only mark chunks dirty
+ *  - copying and greedy meshing one chunk
+ *  - random sphere edits followed by remeshing what they dirtied, the
+ *    sustained edit rate of a single thread
+ *  - remeshing every chunk on 1 to max_threads workers (default, or 0, is
+ *    the number of cores)
+ * The chunk meshes must cover the same surface as meshing the whole world
+ * at once, so no faces are lost or doubled at chunk borders.
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../src/thread_pool.hpp"
+#include "../src/vox.hpp"
+#include "../src/voxel_world.hpp"
+
+template <typename F>
+static double time_ms(F f) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static double surface_area(MeshData const& mesh) {
+    double area = 0;
+    for (size_t i = 0; i + 2 < mesh.indicies.size(); i += 3) {
+        glm::vec3 a = mesh.verticies[mesh.indicies[i]].position;
+        glm::vec3 b = mesh.verticies[mesh.indicies[i + 1]].position;
+        glm::vec3 c = mesh.verticies[mesh.indicies[i + 2]].position;
+        area += glm::length(glm::cross(b - a, c - a)) / 2;
+    }
+    return area;
+}
+
+// meshes what is dirty, returns triangles
+static size_t remesh_dirty(VoxelWorld& world) {
+    std::vector<uint8_t> padded(CHUNK_PADDED * CHUNK_PADDED * CHUNK_PADDED);
+    size_t triangles = 0;
+    for (uint64_t key : world.dirty) {
+        VoxelChunk* chunk = world.find(key);
+        chunk->dirty = false;
+        world.copy_padded(*chunk, padded.data());
+        triangles +=
+            mesh_chunk(padded.data(), world.voxel_size).indicies.size() / 3;
+    }
+    world.dirty.clear();
+    return triangles;
+}
+
+int main(int argc, char** argv) {
+    int side = argc > 1 ? atoi(argv[1]) : 8;
+    unsigned max_threads = argc > 2 ? atoi(argv[2]) : 0;
+    if (!max_threads)
+        max_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (side < 1) side = 1;
+
+    VoxelWorld world;
+    glm::ivec3 min = {0, 0, 0};
+    glm::ivec3 max = {side * CHUNK_SIZE, 2 * CHUNK_SIZE, side * CHUNK_SIZE};
+    double generate_ms = time_ms([&] { world.generate_terrain(min, max); });
+    std::cout << world.chunks.size() << " chunks generated in " << generate_ms
+              << " ms" << std::endl;
+    world.dirty.clear();
+    for (auto& entry : world.chunks) entry.second->dirty = false;
+
+    // single cell edits, each undone so the terrain stays as it was
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> x(0, max.x - 1), y(0, max.y - 1),
+        z(0, max.z - 1), color(1, 255);
+    const int EDITS = 1000000;
+    double edit_ms = time_ms([&] {
+        for (int i = 0; i < EDITS; i += 2) {
+            glm::ivec3 cell = {x(rng), y(rng), z(rng)};
+            uint8_t old = world.get(cell);
+            world.set(cell, old ? 0 : color(rng));
+            world.set(cell, old);
+        }
+    });
+    std::cout << "cell edits: " << EDITS / edit_ms * 1000 << " per second, "
+              << world.dirty.size() << " chunks dirty" << std::endl;
+
+    // every dirty chunk copied and meshed, one at a time
+    size_t chunk_count = world.dirty.size();
+    size_t triangles = 0;
+    double remesh_ms = time_ms([&] { triangles = remesh_dirty(world); });
+    std::cout << "remesh: " << remesh_ms * 1000 / chunk_count
+              << " us per chunk, " << triangles / chunk_count
+              << " triangles per chunk" << std::endl;
+
+    // sustained sphere edits, each remeshed before the next
+    std::uniform_real_distribution<float> at(0, 1);
+    const int SPHERE_EDITS = 200;
+    size_t dirtied = 0;
+    double sphere_ms = time_ms([&] {
+        for (int i = 0; i < SPHERE_EDITS; i++) {
+            glm::vec3 center = glm::vec3(at(rng), at(rng), at(rng)) *
+                               glm::vec3(max.x, max.y, max.z) *
+                               world.voxel_size;
+            world.fill_sphere(center, 1.f, i % 2 ? 0 : 30);
+            dirtied += world.dirty.size();
+            remesh_dirty(world);
+        }
+    });
+    std::cout << "sphere edits with remesh: "
+              << SPHERE_EDITS / sphere_ms * 1000 << " per second ("
+              << (double)dirtied / SPHERE_EDITS << " chunks each)"
+              << std::endl;
+
+    // all chunks on the pool
+    std::vector<VoxelChunk*> all;
+    for (auto& entry : world.chunks) all.push_back(entry.second.get());
+    double serial_ms = 0;
+    for (unsigned threads = 1; threads <= max_threads; threads++) {
+        ThreadPool pool(threads);
+        double ms = time_ms([&] {
+            std::vector<std::future<size_t>> jobs;
+            for (VoxelChunk* chunk : all)
+                jobs.push_back(pool.submit([&world, chunk] {
+                    std::vector<uint8_t> padded(CHUNK_PADDED * CHUNK_PADDED *
+                                                CHUNK_PADDED);
+                    world.copy_padded(*chunk, padded.data());
+                    return mesh_chunk(padded.data(), world.voxel_size)
+                        .indicies.size();
+                }));
+            for (auto& job : jobs) job.get();
+        });
+        if (threads == 1) serial_ms = ms;
+        std::cout << threads << " threads: " << all.size() << " chunks in "
+                  << ms << " ms (" << serial_ms / ms << "x)" << std::endl;
+    }
+
+    // chunk borders against one region over the whole world
+    double chunked_area = 0;
+    std::vector<uint8_t> padded(CHUNK_PADDED * CHUNK_PADDED * CHUNK_PADDED);
+    for (VoxelChunk* chunk : all) {
+        world.copy_padded(*chunk, padded.data());
+        chunked_area +=
+            surface_area(mesh_chunk(padded.data(), world.voxel_size));
+    }
+    MeshData whole;
+    greedy_mesh_region(
+        [&](int x, int y, int z) { return world.get({x, y, z}); },
+        min - glm::ivec3(CHUNK_SIZE), max + glm::ivec3(CHUNK_SIZE),
+        glm::vec3(0), [](glm::vec3 v) { return v; }, world.voxel_size,
+        whole);
+    double whole_area = surface_area(whole);
+    bool same = std::fabs(chunked_area - whole_area) < 1e-3 * whole_area;
+    std::cout << "surface " << (same ? "matches" : "DIFFERS") << " (chunks "
+              << chunked_area << ", whole " << whole_area << ")"
+              << std::endl;
+
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+// camera depth, every texel out covers downsample x downsample of it
+uniform sampler2D tex0;
+uniform int downsample;
+
+out float farthest;
+
+void main() {
+    ivec2 size = textureSize(tex0, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) * downsample;
+    farthest = 0.0;
+    for (int y = 0; y < downsample; y++)
+        for (int x = 0; x < downsample; x++) {
+            ivec2 texel = min(base + ivec2(x, y), size - 1);
+            farthest = max(farthest, texelFetch(tex0, texel, 0).r);
+        }
+}
@@ -0,0 +1,7 @@
+#version 330 core
+
+// one triangle over the whole target, drawn without vertex buffers
+void main() {
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0;
+    gl_Position = vec4(corner, 0.0, 1.0);
+}
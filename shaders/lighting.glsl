@@ -0,0 +1,44 @@
+// shared by the lit fragment shaders through #include "lighting.glsl"
+
+uniform sampler2DArray tex1;  // sun shadow cascades
+
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 sun_matrices[4];
+    vec4 cascade_splits;
+    int cascade_count;
+};
+
+float calculate_shadows(vec3 world_position, float view_depth) {
+    // nothing casts shadows past the last cascade
+    if (cascade_count == 0 || view_depth > cascade_splits[cascade_count - 1])
+        return 1.0;
+
+    int cascade = 0;
+    while (view_depth > cascade_splits[cascade]) cascade++;
+
+    vec4 sun_space_position =
+        sun_matrices[cascade] * vec4(world_position, 1.0);
+    vec3 projected_coords = sun_space_position.xyz / sun_space_position.w;
+    projected_coords = projected_coords * 0.5 + 0.5;
+
+    float closest_depth =
+        texture(tex1, vec3(projected_coords.xy, cascade)).r;
+    float current_depth = projected_coords.z;
+
+    // the shadow pass offsets depth, so no bias is needed here
+    return step(current_depth, closest_depth);
+}
+
+// ambient, diffuse and shadowed sun light on a surface facing normal
+float calculate_lighting(vec3 normal, vec3 world_position, float view_depth) {
+    vec3 light_direction = normalize(vec3(-0.5, -1, -1));
+
+    float ambient_strength = 0.2;
+    float diffuse = max(dot(-light_direction, normal), 0.0) * 0.4;
+
+    float sun_strength = calculate_shadows(world_position, view_depth) * 0.4;
+
+    return ambient_strength + sun_strength + diffuse;
+}
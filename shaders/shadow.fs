@@ -0,0 +1,4 @@
+#version 330 core
+
+// depth only, there is no color attachment to write
+void main() {}
@@ -0,0 +1,20 @@
+#version 330 core
+
+// position only stream or packed grid positions, see Mesh::shadow_vao
+layout(location = 0) in vec3 pos;
+
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 sun_matrices[4];
+    vec4 cascade_splits;
+    int cascade_count;
+};
+
+uniform mat4 model;
+uniform float position_step;  // 1 unless the mesh is packed
+
+void main() {
+    gl_Position =
+        ((projection * view) * model) * vec4(pos * position_step, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+
+// position only stream or packed grid positions, see
+// InstancedMesh::shadow_vao
+layout(location = 0) in vec3 pos;
+layout(location = 3) in mat4 instance_model;  // takes 3..6
+
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 sun_matrices[4];
+    vec4 cascade_splits;
+    int cascade_count;
+};
+
+uniform float position_step;  // 1 unless the mesh is packed
+
+void main() {
+    gl_Position = ((projection * view) * instance_model) *
+                  vec4(pos * position_step, 1.0);
+}
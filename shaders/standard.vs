@@ -9,21 +9,25 @@ smooth out vec3 normal;
 smooth out vec3 vertex_position;
 smooth out vec3 position;
 smooth out vec3 world_position;
-smooth out vec4 sun_position;
+smooth out float view_depth;
+
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 sun_matrices[4];
+    vec4 cascade_splits;
+    int cascade_count;
+};
 
 uniform mat3 normal_model;
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 sun_view;
-uniform mat4 sun_projection;
 
 void main() {
     gl_Position = ((projection * view) * model) * vec4(pos, 1.0);
     vertex_position = pos;
     position = gl_Position.xyz;
     world_position = vec3(model * vec4(pos, 1.0));
-    sun_position = (sun_projection * sun_view) * vec4(world_position, 1.0);
+    view_depth = -(view * vec4(world_position, 1.0)).z;
     UV = tex;
     normal = normal_model * norm;
 }
@@ -0,0 +1,9 @@
+#version 330 core
+
+smooth in vec4 vertex_color;
+
+out vec4 outColor;
+
+void main() {
+    outColor = vertex_color;
+}
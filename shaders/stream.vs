@@ -0,0 +1,20 @@
+#version 330 core
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec4 color;
+
+smooth out vec4 vertex_color;
+
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 sun_matrices[4];
+    vec4 cascade_splits;
+    int cascade_count;
+};
+
+// streamed verticies are already in world space
+void main() {
+    gl_Position = (projection * view) * vec4(pos, 1.0);
+    vertex_color = color;
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+smooth in vec2 UV;
+smooth in vec3 normal;
+smooth in vec3 world_position;
+smooth in float view_depth;
+
+uniform sampler2DArray tex0;  // palettes, see TextureManager
+uniform float palette_layer;
+
+out vec4 outColor;
+
+#include "lighting.glsl"
+
+void main() {
+    vec4 color = texture(tex0, vec3(UV, palette_layer));
+    outColor = calculate_lighting(normal, world_position, view_depth) * color;
+}
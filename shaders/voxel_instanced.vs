@@ -0,0 +1,41 @@
+#version 330 core
+
+// PackedVertex, see pack_voxel_verticies()
+layout(location = 0) in vec3 pos;            // grid units
+layout(location = 1) in uvec2 normal_color;  // normal index, palette texel
+layout(location = 3) in mat4 instance_model;         // takes 3..6
+layout(location = 7) in mat3 instance_normal_model;  // takes 7..9
+
+smooth out vec2 UV;
+smooth out vec3 normal;
+smooth out vec3 vertex_position;
+smooth out vec3 position;
+smooth out vec3 world_position;
+smooth out float view_depth;
+
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 sun_matrices[4];
+    vec4 cascade_splits;
+    int cascade_count;
+};
+
+// same order as PACKED_NORMALS
+const vec3 NORMALS[6] =
+    vec3[](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0),
+           vec3(0, 0, 1), vec3(0, 0, -1));
+
+uniform float position_step;
+
+void main() {
+    vec3 local_position = pos * position_step;
+    gl_Position =
+        ((projection * view) * instance_model) * vec4(local_position, 1.0);
+    vertex_position = local_position;
+    position = gl_Position.xyz;
+    world_position = vec3(instance_model * vec4(local_position, 1.0));
+    view_depth = -(view * vec4(world_position, 1.0)).z;
+    UV = vec2((float(normal_color.y) + 0.5) / 256.0, 0.5);
+    normal = instance_normal_model * NORMALS[normal_color.x];
+}
@@ -0,0 +1,17 @@
+#include "alloc_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+std::atomic<uint64_t> heap_allocations(0);
+
+// array and nothrow forms go through these in libstdc++
+void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
+void operator delete(void* p, size_t) noexcept { free(p); }
@@ -0,0 +1,11 @@
+#ifndef __ALLOC_COUNTER_HPP
+#define __ALLOC_COUNTER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// calls to the global operator new on any thread since start, the game
+// replaces it in alloc_counter.cpp
+extern std::atomic<uint64_t> heap_allocations;
+
+#endif  // __ALLOC_COUNTER_HPP
@@ -0,0 +1,66 @@
+#include "arena.hpp"
+
+#include <algorithm>
+
+Arena frame_arena(1 << 20);
+thread_local Arena load_arena;
+
+Arena::Arena(size_t min_block_size, size_t max_retained)
+    : block(0),
+      used(0),
+      min_block_size(min_block_size),
+      max_retained(max_retained) {}
+
+Arena::~Arena() {
+    for (Block& b : blocks) delete[] b.data;
+}
+
+void Arena::add_block(size_t size) {
+    blocks.push_back({new char[size], size});
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+    if (blocks.empty()) add_block(std::max(min_block_size, size + align));
+
+    for (;;) {
+        Block& b = blocks[block];
+        uintptr_t start = ((uintptr_t)b.data + used + align - 1) & ~(align - 1);
+        size_t end = start - (uintptr_t)b.data + size;
+        if (end <= b.size) {
+            used = end;
+            return (void*)start;
+        }
+
+        // blocks after a rewound mark are reused before growing
+        if (block + 1 == blocks.size())
+            add_block(std::max({min_block_size, b.size * 2, size + align}));
+        block++;
+        used = 0;
+    }
+}
+
+void Arena::rewind(Mark mark) {
+    if (mark.block == 0 && mark.used == 0) {
+        reset();
+        return;
+    }
+    block = mark.block;
+    used = mark.used;
+}
+
+void Arena::reset() {
+    if (blocks.size() > 1) {
+        size_t total = capacity();
+        for (Block& b : blocks) delete[] b.data;
+        blocks.clear();
+        add_block(total <= max_retained ? total : min_block_size);
+    }
+    block = 0;
+    used = 0;
+}
+
+size_t Arena::capacity() const {
+    size_t total = 0;
+    for (Block const& b : blocks) total += b.size;
+    return total;
+}
@@ -0,0 +1,104 @@
+#ifndef __ARENA_HPP
+#define __ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Bump allocator. Allocating is a pointer increment, nothing is freed on its
+ * own, everything goes at once with reset() or back to a mark().
+ *
+ * Memory comes in blocks. A reset that finds more than one block merges
+ * them into one of the total size, so a workload that fitted once fits
+ * without touching the heap from then on. Merged blocks above max_retained
+ * are given back instead.
+ */
+struct Arena {
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    struct Mark {
+        size_t block, used;
+    };
+
+    std::vector<Block> blocks;
+    size_t block;  // allocations come from blocks[block]
+    size_t used;   // bytes of blocks[block] in use
+    size_t min_block_size, max_retained;
+
+    explicit Arena(size_t min_block_size = 64 << 10,
+                   size_t max_retained = 64 << 20);
+    Arena(Arena const&) = delete;
+    Arena& operator=(Arena const&) = delete;
+    ~Arena();
+
+    void* allocate(size_t size, size_t align);
+    template <typename T>
+    T* allocate(size_t count) {
+        return (T*)allocate(count * sizeof(T), alignof(T));
+    }
+
+    Mark mark() const { return {block, used}; }
+    void rewind(Mark mark);
+    void reset();
+    size_t capacity() const;
+
+   private:
+    void add_block(size_t size);
+};
+
+// scratch data of the current frame, reset at the start of every frame
+extern Arena frame_arena;
+// temporaries while loading, one per thread, used through ArenaScope
+extern thread_local Arena load_arena;
+
+inline Arena& get_frame_arena() { return frame_arena; }
+inline Arena& get_load_arena() { return load_arena; }
+
+// STL allocator drawing from an arena, deallocation is a no-op
+template <typename T, Arena& (*get_arena)()>
+struct ArenaAllocator {
+    typedef T value_type;
+    template <typename U>
+    struct rebind {
+        typedef ArenaAllocator<U, get_arena> other;
+    };
+
+    ArenaAllocator() = default;
+    template <typename U>
+    ArenaAllocator(ArenaAllocator<U, get_arena> const&) {}
+
+    T* allocate(size_t count) {
+        return get_arena().template allocate<T>(count);
+    }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(ArenaAllocator<U, get_arena> const&) const {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(ArenaAllocator<U, get_arena> const&) const {
+        return false;
+    }
+};
+
+// must not outlive the frame it was filled in
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T, get_frame_arena>>;
+template <typename T>
+using LoadVector = std::vector<T, ArenaAllocator<T, get_load_arena>>;
+
+// rewinds the arena to where it was when the scope was entered
+struct ArenaScope {
+    Arena& arena;
+    Arena::Mark mark;
+
+    explicit ArenaScope(Arena& arena) : arena(arena), mark(arena.mark()) {}
+    ~ArenaScope() { arena.rewind(mark); }
+};
+
+#endif  // __ARENA_HPP
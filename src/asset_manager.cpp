@@ -0,0 +1,209 @@
+#include "asset_manager.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lod.hpp"
+#include "mesh_cache.hpp"
+#include "obj.hpp"
+#include "texture_manager.hpp"
+#include "util.hpp"
+#include "vox.hpp"
+
+// magenta, so a texture that never arrives is easy to spot
+static const uint8_t PLACEHOLDER_TEXEL[4] = {255, 0, 255, 255};
+
+static bool has_extension(std::string const& path, const char* extension) {
+    size_t length = std::char_traits<char>::length(extension);
+    return path.size() >= length &&
+           path.compare(path.size() - length, length, extension) == 0;
+}
+
+AssetManager::AssetManager() : pending(0) {}
+
+void AssetManager::queue_upload(size_t bytes, std::function<void()> run) {
+    std::lock_guard<std::mutex> lock(uploads_mutex);
+    uploads.push_back({bytes, std::move(run)});
+}
+
+GLuint AssetManager::load_texture(const char* filename) {
+    std::string path = filename;
+    if (GLuint texture = texture_manager.find(path)) return texture;
+
+    GLuint texture = create_texture_rgba(PLACEHOLDER_TEXEL, 1, 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    texture_manager.textures[path] = texture;
+
+    pending++;
+    pool.submit([this, path, texture] {
+        auto image = std::make_shared<TextureImage>();
+        if (!load_texture_image(path.c_str(), *image)) {
+            // reported from the context thread like the rest
+            queue_upload(0, [path] {
+                std::cerr << "[ERROR] Failed to load texture: " << path
+                          << std::endl;
+            });
+            return;
+        }
+
+        queue_upload(image->pixels.size(), [path, texture, image] {
+            texture_manager.upload(texture, *image);
+            std::cout << "[INFO] Loaded texture \"" << path << "\" with id: "
+                      << texture << (image->from_cache ? " from cache" : "")
+                      << std::endl;
+        });
+    });
+    return texture;
+}
+
+int AssetManager::load_palette(const char* filename) {
+    std::string path = filename;
+    int layer = texture_manager.find_palette(path);
+    if (layer >= 0) return layer;
+    layer = texture_manager.add_palette(path);
+
+    pending++;
+    pool.submit([this, path, layer] {
+        auto image = std::make_shared<TextureImage>();
+        if (!load_texture_image(path.c_str(), *image)) {
+            queue_upload(0, [path] {
+                std::cerr << "[ERROR] Failed to load palette: " << path
+                          << std::endl;
+            });
+            return;
+        }
+
+        queue_upload(image->pixels.size(), [path, layer, image] {
+            if (!texture_manager.upload_palette(layer, *image)) {
+                std::cerr << "[ERROR] Palette is not "
+                          << TextureManager::PALETTE_SIZE
+                          << "x1: " << path << std::endl;
+                return;
+            }
+            std::cout << "[INFO] Loaded palette \"" << path << "\" into layer "
+                      << layer << (image->from_cache ? " from cache" : "")
+                      << std::endl;
+        });
+    });
+    return layer;
+}
+
+void AssetManager::load_mesh(const char* filename, Mesh* mesh) {
+    pending++;
+    std::string path = filename;
+    pool.submit([this, path, mesh] {
+        if (has_extension(path, ".vox")) {
+            VoxModel model;
+            if (!parse_vox_format(load_whole_file(path.c_str()), model)) {
+                queue_upload(0, [path] {
+                    std::cerr << "[ERROR] Failed to load VOX model: " << path
+                              << std::endl;
+                });
+                return;
+            }
+
+            auto lods = std::make_shared<std::vector<MeshLod>>();
+            auto data = std::make_shared<MeshData>(
+                merge_lods(build_vox_lods(model), *lods));
+            auto palette = std::make_shared<std::vector<uint32_t>>();
+            if (model.has_palette)
+                palette->assign(model.palette, model.palette + 256);
+            size_t bytes = data->verticies.size() * sizeof(Vertex) +
+                           data->indicies.size() * sizeof(uint32_t);
+
+            queue_upload(bytes, [path, mesh, data, lods, palette] {
+                mesh->replace_geometry(*data);  // packs if the mesh is packed
+                mesh->set_lods(*lods);
+                // same rule as create_from_vox, an explicit palette wins
+                if (!mesh->tex0 && !palette->empty()) {
+                    mesh->tex0 = texture_manager.palette_array;
+                    mesh->palette_layer =
+                        texture_manager.palette_for(palette->data());
+                }
+                std::cout << "[INFO] Loaded mesh \"" << path << "\": "
+                          << mesh->index_count / 3 << " triangles, "
+                          << mesh->vertex_bytes() / 1024.f
+                          << " KiB of verticies" << std::endl;
+            });
+            return;
+        }
+
+        auto cache = std::make_shared<MappedMeshCache>();
+        if (open_mesh_cache_for(path.c_str(), *cache)) {
+            // uploaded straight from the mapping, the upload keeps it open
+            size_t bytes = cache->size - sizeof(MeshCacheHeader);
+            queue_upload(bytes, [path, mesh, cache] {
+                GLenum index_type =
+                    cache->header->index_size == sizeof(uint16_t)
+                        ? GL_UNSIGNED_SHORT
+                        : GL_UNSIGNED_INT;
+                mesh->replace_geometry(
+                    cache->verticies, cache->header->vertex_count,
+                    cache->indicies, cache->header->index_count, index_type);
+                mesh->set_lods(std::vector<MeshLod>(
+                    cache->header->lods,
+                    cache->header->lods + cache->header->lod_count));
+                std::cout << "[INFO] Loaded mesh \"" << path
+                          << "\" from cache" << std::endl;
+            });
+            return;
+        }
+
+        std::string source = load_whole_file(path.c_str());
+        ObjData obj = parse_obj_data(source);
+        auto lods = std::make_shared<std::vector<MeshLod>>();
+        auto data = std::make_shared<MeshData>(
+            merge_lods(build_mesh_lods(assemble_obj_indexed(obj)), *lods));
+        SourceStamp stamp;
+        if (get_source_stamp(path.c_str(), stamp))
+            write_mesh_cache(mesh_cache_path(path.c_str()).c_str(), *data,
+                             stamp, hash_bytes(source), *lods);
+
+        size_t bytes = data->verticies.size() * sizeof(Vertex) +
+                       data->indicies.size() * sizeof(uint32_t);
+        queue_upload(bytes, [path, mesh, data, lods] {
+            mesh->replace_geometry(*data);
+            mesh->set_lods(*lods);
+            std::cout << "[INFO] Loaded mesh \"" << path << "\": "
+                      << data->verticies.size() << " verticies" << std::endl;
+        });
+    });
+}
+
+size_t AssetManager::process_uploads(size_t byte_budget) {
+    size_t uploaded = 0;
+    bool first = true;
+    for (;;) {
+        Upload upload;
+        {
+            std::lock_guard<std::mutex> lock(uploads_mutex);
+            if (uploads.empty()) break;
+            if (!first && uploaded + uploads.front().bytes > byte_budget)
+                break;
+            upload = std::move(uploads.front());
+            uploads.pop_front();
+        }
+        upload.run();
+        uploaded += upload.bytes;
+        pending--;
+        first = false;
+    }
+    return uploaded;
+}
+
+void AssetManager::finish() {
+    while (!idle()) {
+        if (!process_uploads(SIZE_MAX)) std::this_thread::yield();
+    }
+}
+
+void AssetManager::destroy() {
+    pool.shutdown();
+    std::lock_guard<std::mutex> lock(uploads_mutex);
+    pending -= uploads.size();
+    uploads.clear();
+}
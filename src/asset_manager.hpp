@@ -0,0 +1,59 @@
+#ifndef __ASSET_MANAGER_HPP
+#define __ASSET_MANAGER_HPP
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "mesh.hpp"
+#include "thread_pool.hpp"
+
+/*
+ * Loads assets in the background. File I/O, image decoding and OBJ/VOX
+ * parsing run on the pool, only the GL upload is left for the context
+ * thread and queued until process_uploads() is called.
+ *
+ * The handles are usable right away: load_texture() returns a texture
+ * holding a 1x1 placeholder, load_palette() a layer filled with magenta
+ * and load_mesh() fills a mesh created by Mesh::create_placeholder().
+ * All keep their GL names or layers when the real data arrives, so draw
+ * items, instanced VAOs and materials referring to them stay valid.
+ * Meshes must outlive the manager or be loaded before they go.
+ */
+struct AssetManager {
+    struct Upload {
+        size_t bytes;  // of GL data, counted against the frame budget
+        std::function<void()> run;
+    };
+
+    ThreadPool pool;
+    std::mutex uploads_mutex;
+    std::deque<Upload> uploads;  // decoded, waiting for the context thread
+    std::atomic<int> pending;    // requested but not uploaded yet
+
+    AssetManager();
+
+    // both once per path, see TextureManager
+    GLuint load_texture(const char* filename);
+    // layer in texture_manager.palette_array, for packed meshes
+    int load_palette(const char* filename);
+    // OBJ (through the mesh cache) or VOX, by file extension
+    void load_mesh(const char* filename, Mesh* mesh);
+
+    // runs queued uploads until byte_budget is spent, always at least one so
+    // a big asset can't stall forever, returns bytes uploaded
+    size_t process_uploads(size_t byte_budget);
+    // blocks until everything requested so far is uploaded
+    void finish();
+    bool idle() const { return pending == 0; }
+    void destroy();
+
+   private:
+    void queue_upload(size_t bytes, std::function<void()> run);
+};
+
+#endif  // __ASSET_MANAGER_HPP
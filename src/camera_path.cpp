@@ -0,0 +1,90 @@
+#include "camera_path.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+bool CameraPath::load(const char* filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "[ERROR] Failed to open camera path: " << filename
+                  << std::endl;
+        return false;
+    }
+
+    keys.clear();
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); line_number++) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ss(line);
+        CameraKey key;
+        if (!(ss >> key.time >> key.position.x >> key.position.y >>
+              key.position.z >> key.pitch >> key.yaw)) {
+            std::cerr << "[ERROR] " << filename << ":" << line_number
+                      << ": expected \"time x y z pitch yaw\"" << std::endl;
+            return false;
+        }
+        if (!keys.empty() && key.time < keys.back().time) {
+            std::cerr << "[ERROR] " << filename << ":" << line_number
+                      << ": keys are not sorted by time" << std::endl;
+            return false;
+        }
+        keys.push_back(key);
+    }
+
+    if (keys.empty()) {
+        std::cerr << "[ERROR] Camera path has no keys: " << filename
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CameraPath::save(const char* filename) const {
+    std::ofstream file(filename);
+    if (!file) {
+        std::cerr << "[ERROR] Failed to write camera path: " << filename
+                  << std::endl;
+        return false;
+    }
+    // enough digits that every float reads back the same
+    file << std::setprecision(std::numeric_limits<float>::max_digits10);
+    file << "# time x y z pitch yaw\n";
+    for (CameraKey const& key : keys)
+        file << key.time << " " << key.position.x << " " << key.position.y
+             << " " << key.position.z << " " << key.pitch << " " << key.yaw
+             << "\n";
+    return (bool)file;
+}
+
+CameraKey CameraPath::sample(float time) const {
+    if (time <= keys.front().time) return keys.front();
+    if (time >= keys.back().time) return keys.back();
+
+    size_t i = 1;
+    while (keys[i].time < time) i++;
+    CameraKey const& a = keys[i - 1];
+    CameraKey const& b = keys[i];
+    float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 1;
+
+    return {time, glm::mix(a.position, b.position, t),
+            glm::mix(a.pitch, b.pitch, t), glm::mix(a.yaw, b.yaw, t)};
+}
+
+CameraPath CameraPath::orbit(float radius, float height, float duration) {
+    const int STEPS = 64;
+    const float TAU = 6.2831853f;
+
+    CameraPath path;
+    for (int i = 0; i <= STEPS; i++) {
+        float angle = TAU * i / STEPS;
+        // the camera looks down -z at yaw 0, so face the origin
+        glm::vec3 position = {glm::sin(angle) * radius, height,
+                              glm::cos(angle) * radius};
+        path.keys.push_back({duration * i / STEPS, position, -0.15f, angle});
+    }
+    return path;
+}
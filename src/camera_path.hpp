@@ -0,0 +1,31 @@
+#ifndef __CAMERA_PATH_HPP
+#define __CAMERA_PATH_HPP
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct CameraKey {
+    float time;
+    glm::vec3 position;
+    float pitch, yaw;
+};
+
+/*
+ * Camera keyframes replayed by --headless, one per line as text:
+ *
+ *   time x y z pitch yaw
+ *
+ * Lines starting with # are comments. Keys must be sorted by time.
+ */
+struct CameraPath {
+    std::vector<CameraKey> keys;
+
+    bool load(const char* filename);
+    bool save(const char* filename) const;
+    // linear between keys, clamped to the first and last key
+    CameraKey sample(float time) const;
+    // circle around the origin, used when no path is given
+    static CameraPath orbit(float radius, float height, float duration);
+};
+
+#endif  // __CAMERA_PATH_HPP
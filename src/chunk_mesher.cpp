@@ -0,0 +1,100 @@
+#include "chunk_mesher.hpp"
+
+#include <climits>
+#include <glm/gtc/matrix_transform.hpp>
+#include <memory>
+#include <thread>
+#include <vector>
+
+ChunkMesher::ChunkMesher(VoxelWorld& world, ThreadPool& pool, GLuint prog,
+                         GLuint palette, int palette_layer)
+    : world(world),
+      pool(pool),
+      prog(prog),
+      palette(palette),
+      palette_layer(palette_layer),
+      remeshed(0) {}
+
+int ChunkMesher::update(int max_swaps) {
+    // chunks with a job in flight stay dirty until it is back
+    size_t kept = 0;
+    for (uint64_t key : world.dirty) {
+        VoxelChunk* chunk = world.find(key);
+        if (meshing.count(key)) {
+            world.dirty[kept++] = key;
+            continue;
+        }
+        chunk->dirty = false;
+        meshing.insert(key);
+
+        // the job works on a copy, later edits can't race with it
+        auto padded = std::make_shared<std::vector<uint8_t>>(
+            CHUNK_PADDED * CHUNK_PADDED * CHUNK_PADDED);
+        world.copy_padded(*chunk, padded->data());
+        float voxel_size = world.voxel_size;
+        pool.submit([this, key, padded, voxel_size] {
+            MeshData mesh = mesh_chunk(padded->data(), voxel_size);
+            std::lock_guard<std::mutex> lock(results_mutex);
+            results.push_back({key, std::move(mesh)});
+        });
+    }
+    world.dirty.resize(kept);
+
+    int swapped = 0;
+    while (swapped < max_swaps) {
+        Result result;
+        {
+            std::lock_guard<std::mutex> lock(results_mutex);
+            if (results.empty()) break;
+            result = std::move(results.front());
+            results.pop_front();
+        }
+        swap_in(result);
+        swapped++;
+    }
+    return swapped;
+}
+
+void ChunkMesher::swap_in(Result& result) {
+    meshing.erase(result.key);
+    remeshed++;
+
+    auto it = meshes.find(result.key);
+    if (result.mesh.indicies.empty()) {  // dug out completely
+        if (it != meshes.end()) meshes.erase(it);
+        return;
+    }
+    if (it != meshes.end()) {
+        it->second.replace_geometry(result.mesh);
+        return;
+    }
+
+    glm::ivec3 coord = world.find(result.key)->coord;
+    Mesh mesh(std::move(result.mesh), world.voxel_size, prog, palette);
+    mesh.model = glm::translate(glm::mat4(1), world.chunk_origin(coord));
+    mesh.palette_layer = palette_layer;
+    meshes.emplace(result.key, std::move(mesh));
+}
+
+void ChunkMesher::finish() {
+    while (!idle()) {
+        if (!update(INT_MAX)) std::this_thread::yield();
+    }
+}
+
+void ChunkMesher::push(RenderQueue& queue) {
+    for (auto& entry : meshes) queue.push(&entry.second);
+}
+
+void ChunkMesher::destroy() {
+    // jobs hold this, so the pool must still be running them
+    while (!meshing.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(results_mutex);
+            for (Result const& result : results) meshing.erase(result.key);
+            results.clear();
+        }
+        if (!meshing.empty()) std::this_thread::yield();
+    }
+    meshes.clear();
+}
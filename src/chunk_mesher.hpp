@@ -0,0 +1,62 @@
+#ifndef __CHUNK_MESHER_HPP
+#define __CHUNK_MESHER_HPP
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "mesh.hpp"
+#include "render_queue.hpp"
+#include "thread_pool.hpp"
+#include "voxel_world.hpp"
+
+/*
+ * Keeps a packed Mesh per non empty chunk of a VoxelWorld. Dirty chunks
+ * are copied with their borders and greedy meshed on the pool, finished
+ * meshes are swapped in by update() on the context thread. Buffers are
+ * re-filled in place, so a chunk keeps its GL names across edits.
+ *
+ * A chunk edited while its job runs stays dirty and is meshed again once
+ * the job is back, so at most one job per chunk is in flight.
+ */
+struct ChunkMesher {
+    struct Result {
+        uint64_t key;
+        MeshData mesh;
+    };
+
+    VoxelWorld& world;
+    ThreadPool& pool;
+    GLuint prog, palette;  // program reading packed verticies, palette array
+    int palette_layer;
+    std::unordered_map<uint64_t, Mesh> meshes;
+    std::unordered_set<uint64_t> meshing;  // keys with a job in flight
+
+    std::mutex results_mutex;
+    std::deque<Result> results;  // meshed, waiting for the context thread
+
+    unsigned remeshed;  // total meshes swapped in
+
+    ChunkMesher(VoxelWorld& world, ThreadPool& pool, GLuint prog,
+                GLuint palette, int palette_layer);
+    ChunkMesher(ChunkMesher const&) = delete;
+    ChunkMesher& operator=(ChunkMesher const&) = delete;
+
+    // starts jobs for dirty chunks and swaps in up to max_swaps meshes,
+    // returns how many were swapped
+    int update(int max_swaps);
+    // blocks until no chunk is dirty or being meshed
+    void finish();
+    bool idle() const { return world.dirty.empty() && meshing.empty(); }
+    void push(RenderQueue& queue);
+    // waits for jobs still using this mesher, then drops the meshes
+    void destroy();
+
+   private:
+    void swap_in(Result& result);
+};
+
+#endif  // __CHUNK_MESHER_HPP
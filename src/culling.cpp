@@ -0,0 +1,70 @@
+#include "culling.hpp"
+
+#include <algorithm>
+
+Bounds compute_bounds(const glm::vec3* positions, size_t count) {
+    Bounds bounds = {glm::vec3(0), glm::vec3(0), glm::vec3(0), 0};
+    if (!count) return bounds;
+
+    bounds.min = bounds.max = positions[0];
+    for (size_t i = 1; i < count; i++) {
+        bounds.min = glm::min(bounds.min, positions[i]);
+        bounds.max = glm::max(bounds.max, positions[i]);
+    }
+
+    // sphere around the box center, tighter than half the box diagonal
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    float radius2 = 0;
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 d = positions[i] - bounds.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    bounds.radius = glm::sqrt(radius2);
+    return bounds;
+}
+
+Frustum extract_frustum(glm::mat4 const& view_projection) {
+    // Gribb-Hartmann, planes are sums and differences of matrix rows
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = {view_projection[0][i], view_projection[1][i],
+                   view_projection[2][i], view_projection[3][i]};
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];  // left
+    frustum.planes[1] = rows[3] - rows[0];  // right
+    frustum.planes[2] = rows[3] + rows[1];  // bottom
+    frustum.planes[3] = rows[3] - rows[1];  // top
+    frustum.planes[4] = rows[3] + rows[2];  // near
+    frustum.planes[5] = rows[3] - rows[2];  // far
+
+    for (glm::vec4& plane : frustum.planes)
+        plane = plane / glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+CullStats cull_spheres(Frustum const& frustum, const float* px,
+                       const float* py, const float* pz, const float* pr,
+                       size_t n, uint8_t* out) {
+    float a[6], b[6], c[6], d[6];
+    for (int p = 0; p < 6; p++) {
+        a[p] = frustum.planes[p].x;
+        b[p] = frustum.planes[p].y;
+        c[p] = frustum.planes[p].z;
+        d[p] = frustum.planes[p].w;
+    }
+
+    // branchless over all planes so the loop vectorizes across spheres
+    unsigned visible_count = 0;
+    for (size_t i = 0; i < n; i++) {
+        float sx = px[i], sy = py[i], sz = pz[i], sr = -pr[i];
+        int inside = 1;
+#pragma GCC unroll 6
+        for (int p = 0; p < 6; p++)
+            inside &= a[p] * sx + b[p] * sy + c[p] * sz + d[p] >= sr;
+        out[i] = inside;
+        visible_count += inside;
+    }
+
+    return {visible_count, (unsigned)n - visible_count, 0};
+}
@@ -0,0 +1,36 @@
+#ifndef __CULLING_HPP
+#define __CULLING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "vertex.hpp"
+
+// local space bounding volumes of a mesh
+struct Bounds {
+    glm::vec3 min, max;
+    glm::vec3 center;
+    float radius;
+};
+
+Bounds compute_bounds(const glm::vec3* positions, size_t count);
+
+// planes point inwards, normalized so distances are in world units
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+Frustum extract_frustum(glm::mat4 const& view_projection);
+
+struct CullStats {
+    unsigned visible, culled;
+    unsigned occluded;  // inside the frustum but hidden, see HiZBuffer
+};
+
+// sets visible[i] to 1 for spheres inside, thread safe, arrays of count
+CullStats cull_spheres(Frustum const& frustum, const float* x, const float* y,
+                       const float* z, const float* radius, size_t count,
+                       uint8_t* visible);
+
+#endif  // __CULLING_HPP
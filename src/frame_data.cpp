@@ -0,0 +1,102 @@
+#include "frame_data.hpp"
+
+#include <cstring>
+#include <iostream>
+
+FrameUniformBuffer frame_uniforms;
+
+bool wait_for_fence(GLsync fence) {
+    for (int tries = 1; tries <= FENCE_WAIT_TRIES; tries++) {
+        GLenum status =
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NS);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+            return true;
+        if (status == GL_WAIT_FAILED) {
+            std::cerr << "[ERROR] Waiting for a GPU fence failed" << std::endl;
+            return false;
+        }
+    }
+    std::cerr << "[ERROR] GPU fence still pending after "
+              << FENCE_WAIT_NS * FENCE_WAIT_TRIES / 1000000
+              << " ms, giving up on it" << std::endl;
+    return false;
+}
+
+void FrameUniformBuffer::init() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    slot_size = (sizeof(FrameData) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER,
+                 slot_size * SLOTS_PER_FRAME * FRAMES_IN_FLIGHT, 0,
+                 GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    for (GLsync& fence : fences) fence = 0;
+    frame = 0;
+    slot = 0;
+}
+
+void FrameUniformBuffer::begin_frame() {
+    frame = (frame + 1) % FRAMES_IN_FLIGHT;
+    slot = 0;
+
+    // only blocks if the GPU is more than FRAMES_IN_FLIGHT frames behind
+    if (fences[frame]) {
+        // a GPU this far behind may still read the slots, give the ring new
+        // storage instead of writing over them
+        if (!wait_for_fence(fences[frame])) {
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER,
+                         slot_size * SLOTS_PER_FRAME * FRAMES_IN_FLIGHT, 0,
+                         GL_STREAM_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        glDeleteSync(fences[frame]);
+        fences[frame] = 0;
+    }
+}
+
+void FrameUniformBuffer::end_frame() {
+    if (fences[frame]) glDeleteSync(fences[frame]);
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void FrameUniformBuffer::write(FrameData const& data) {
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+
+    if (slot == SLOTS_PER_FRAME) {
+        // out of slots for this frame, orphan the whole ring and start over
+        glBufferData(GL_UNIFORM_BUFFER,
+                     slot_size * SLOTS_PER_FRAME * FRAMES_IN_FLIGHT, 0,
+                     GL_STREAM_DRAW);
+        slot = 0;
+    }
+
+    GLintptr offset = (frame * SLOTS_PER_FRAME + slot) * slot_size;
+    slot++;
+
+    void* dst = glMapBufferRange(GL_UNIFORM_BUFFER, offset, sizeof(FrameData),
+                                 GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                                     GL_MAP_INVALIDATE_RANGE_BIT);
+    if (dst) {
+        memcpy(dst, &data, sizeof(FrameData));
+        // false if the storage was lost while mapped
+        if (!glUnmapBuffer(GL_UNIFORM_BUFFER)) dst = 0;
+    }
+    if (!dst)
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(FrameData), &data);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, ubo, offset,
+                      sizeof(FrameData));
+}
+
+void FrameUniformBuffer::destroy() {
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = 0;
+    }
+    glDeleteBuffers(1, &ubo);
+}
@@ -0,0 +1,57 @@
+#ifndef __FRAME_DATA_HPP
+#define __FRAME_DATA_HPP
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// uniform block binding point of FrameData, set for every program on link
+const GLuint FRAME_DATA_BINDING = 0;
+
+// shadow map cascades of the sun, see shadows.hpp
+const int SHADOW_CASCADES = 4;
+
+// std140 layout of the FrameData uniform block in shaders
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 sun_matrices[SHADOW_CASCADES];  // projection * view
+    glm::vec4 cascade_splits;  // view space far distance of each cascade
+    int32_t cascade_count;     // 0 draws without shadows
+    int32_t padding[3];
+};
+
+// a fence wait gives up after FENCE_WAIT_TRIES waits of FENCE_WAIT_NS
+const GLuint64 FENCE_WAIT_NS = 100000000;
+const int FENCE_WAIT_TRIES = 50;
+
+// blocks until the GPU passed fence, false if it never does, e.g. after
+// the context was lost, so callers don't hang with it
+bool wait_for_fence(GLsync fence);
+
+/*
+ * Ring of FrameData slots in one uniform buffer. Every write goes to a fresh
+ * slot through an unsynchronized mapping, a fence per frame keeps the CPU
+ * from overwriting slots the GPU may still read.
+ */
+struct FrameUniformBuffer {
+    static const int FRAMES_IN_FLIGHT = 3;
+    static const int SLOTS_PER_FRAME = 16;
+
+    GLuint ubo;
+    GLsizeiptr slot_size;
+    GLsync fences[FRAMES_IN_FLIGHT];
+    int frame, slot;
+
+    void init();
+    void begin_frame();
+    void end_frame();
+    // copies data into the next slot and binds it to FRAME_DATA_BINDING
+    void write(FrameData const& data);
+    void destroy();
+};
+
+extern FrameUniformBuffer frame_uniforms;
+
+#endif  // __FRAME_DATA_HPP
@@ -0,0 +1,103 @@
+#include "instancing.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <glm/matrix.hpp>
+
+#include "render_queue.hpp"
+
+InstancedMesh::InstancedMesh(Mesh* mesh, GLuint shader_prog)
+    : mesh(mesh), prog(shader_prog), instance_capacity(0) {
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    // geometry comes from the mesh buffers
+    mesh->setup_vertex_attribs(false);
+
+    // one mat4 and one mat3 per instance, a column per attribute location
+    glGenBuffers(1, &instance_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    for (GLuint i = 0; i < 4; i++) {
+        glVertexAttribPointer(
+            3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+            (void*)(offsetof(InstanceData, model) + i * sizeof(glm::vec4)));
+        glVertexAttribDivisor(3 + i, 1);
+        glEnableVertexAttribArray(3 + i);
+    }
+    for (GLuint i = 0; i < 3; i++) {
+        glVertexAttribPointer(7 + i, 3, GL_FLOAT, GL_FALSE,
+                              sizeof(InstanceData),
+                              (void*)(offsetof(InstanceData, normal_model) +
+                                      i * sizeof(glm::vec3)));
+        glVertexAttribDivisor(7 + i, 1);
+        glEnableVertexAttribArray(7 + i);
+    }
+    glBindVertexArray(0);
+
+    glGenVertexArrays(1, &shadow_vao);
+    glBindVertexArray(shadow_vao);
+    mesh->setup_vertex_attribs(true);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    for (GLuint i = 0; i < 4; i++) {
+        glVertexAttribPointer(
+            3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+            (void*)(offsetof(InstanceData, model) + i * sizeof(glm::vec4)));
+        glVertexAttribDivisor(3 + i, 1);
+        glEnableVertexAttribArray(3 + i);
+    }
+    glBindVertexArray(0);
+
+    glUseProgram(prog);
+    glUniform1i(glGetUniformLocation(prog, "tex0"), 0);
+    glUniform1i(glGetUniformLocation(prog, "tex1"), 1);
+    glUseProgram(0);
+}
+
+void InstancedMesh::add(glm::mat4 const& model) {
+    instances.push_back({model, glm::transpose(glm::inverse(model))});
+}
+
+void InstancedMesh::set(size_t i, glm::mat4 const& model) {
+    instances[i] = {model, glm::transpose(glm::inverse(model))};
+}
+
+void InstancedMesh::upload() {
+    GLsizeiptr size = instances.size() * sizeof(InstanceData);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    if (size > instance_capacity) {
+        instance_capacity = size;
+        glBufferData(GL_ARRAY_BUFFER, size, instances.data(), GL_DYNAMIC_DRAW);
+    } else {
+        // orphan old storage so the GPU can keep reading last frame's data
+        glBufferData(GL_ARRAY_BUFFER, instance_capacity, 0, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstancedMesh::draw(int lod) {
+    if (instances.empty()) return;
+    if (mesh->ebo) {
+        MeshLod const& range =
+            mesh->lods[std::min<size_t>(lod, mesh->lods.size() - 1)];
+        size_t index_size = mesh->index_type == GL_UNSIGNED_SHORT
+                                ? sizeof(uint16_t)
+                                : sizeof(uint32_t);
+        glDrawElementsInstanced(GL_TRIANGLES, range.index_count,
+                                mesh->index_type,
+                                (void*)(range.first_index * index_size),
+                                instances.size());
+        render_stats.triangles += range.index_count / 3 * instances.size();
+    } else {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, mesh->vertex_count,
+                              instances.size());
+        render_stats.triangles += mesh->vertex_count / 3 * instances.size();
+    }
+    render_stats.draw_calls++;
+}
+
+InstancedMesh::~InstancedMesh() {
+    glDeleteBuffers(1, &instance_vbo);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteVertexArrays(1, &shadow_vao);
+}
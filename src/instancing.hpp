@@ -0,0 +1,45 @@
+#ifndef __INSTANCING_HPP
+#define __INSTANCING_HPP
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "mesh.hpp"
+
+// per instance vertex attributes, see shaders/voxel_instanced.vs
+struct InstanceData {
+    glm::mat4 model;
+    glm::mat3 normal_model;
+};
+
+/*
+ * Draws many copies of a mesh with one call. Geometry buffers are shared
+ * with the mesh, per instance transforms live in a dynamic buffer read with
+ * attribute divisor 1.
+ */
+struct InstancedMesh {
+    Mesh* mesh;
+    GLuint prog;  // shaders/voxel_instanced.vs, the mesh must be packed
+    GLuint vao, instance_vbo;
+    GLuint shadow_vao;  // mesh positions and instance models only
+    GLsizeiptr instance_capacity;
+    std::vector<InstanceData> instances;
+
+    InstancedMesh(Mesh* mesh, GLuint shader_prog);
+    InstancedMesh(InstancedMesh const&) = delete;
+    InstancedMesh& operator=(InstancedMesh const&) = delete;
+    ~InstancedMesh();
+
+    // appends instance, normal matrix is computed once here
+    void add(glm::mat4 const& model);
+    void set(size_t i, glm::mat4 const& model);
+    // sends instances to the GPU, call after changing them
+    void upload();
+    // issues the instanced draw call, program and textures must be bound,
+    // all instances are drawn at the same level of detail
+    void draw(int lod = 0);
+};
+
+#endif  // __INSTANCING_HPP
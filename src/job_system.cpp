@@ -0,0 +1,107 @@
+#include "job_system.hpp"
+
+// queue of the worker running on this thread, 0 for everyone else
+static thread_local const JobSystem* worker_system = 0;
+static thread_local size_t worker_queue = 0;
+
+static void execute(Job const& job) {
+    job.run(job.data, job.index);
+    job.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+JobSystem::JobSystem(unsigned threads)
+    : queued(0), stopping(false), steals(0) {
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+    queues.reserve(threads);
+    for (unsigned i = 0; i < threads; i++) queues.emplace_back(new Queue());
+    workers.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; i++)
+        workers.emplace_back(&JobSystem::run, this, i);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+size_t JobSystem::own_queue() const {
+    return worker_system == this ? worker_queue : 0;
+}
+
+void JobSystem::submit(void (*run)(void* data, size_t index), void* data,
+                       size_t index, JobCounter& counter) {
+    Job job = {run, data, index, &counter};
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+    // counted before it can be taken, so the count never goes below 0
+    queued.fetch_add(1);
+    Queue& queue = *queues[own_queue()];
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        full = queue.size == QUEUE_CAPACITY;
+        if (!full)
+            queue.jobs[(queue.front + queue.size++) % QUEUE_CAPACITY] = job;
+    }
+    if (full) {
+        queued.fetch_sub(1);
+        execute(job);
+        return;
+    }
+
+    // taking the lock orders this against a worker about to sleep
+    { std::lock_guard<std::mutex> lock(sleep_mutex); }
+    wake.notify_one();
+}
+
+bool JobSystem::try_run(size_t own) {
+    Job job;
+    bool found = false;
+    {  // newest own job first, its data is likely still in cache
+        Queue& queue = *queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.size) {
+            queue.size--;
+            job = queue.jobs[(queue.front + queue.size) % QUEUE_CAPACITY];
+            found = true;
+        }
+    }
+    // oldest job of someone else, the biggest piece of work left there
+    for (size_t i = 1; !found && i < queues.size(); i++) {
+        Queue& queue = *queues[(own + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.size) {
+            job = queue.jobs[queue.front];
+            queue.front = (queue.front + 1) % QUEUE_CAPACITY;
+            queue.size--;
+            found = true;
+            steals.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!found) return false;
+
+    queued.fetch_sub(1);
+    execute(job);
+    return true;
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    size_t own = own_queue();
+    while (counter.pending.load(std::memory_order_acquire))
+        if (!try_run(own)) std::this_thread::yield();
+}
+
+void JobSystem::run(size_t queue) {
+    worker_system = this;
+    worker_queue = queue;
+    for (;;) {
+        if (try_run(queue)) continue;
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping) return;
+    }
+}
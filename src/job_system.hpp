@@ -0,0 +1,101 @@
+#ifndef __JOB_SYSTEM_HPP
+#define __JOB_SYSTEM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// jobs still queued or running, wait() returns once it drops to 0
+struct JobCounter {
+    std::atomic<unsigned> pending{0};
+};
+
+// a function pointer and its arguments, so queueing never allocates
+struct Job {
+    void (*run)(void* data, size_t index);
+    void* data;
+    size_t index;
+    JobCounter* counter;
+};
+
+/*
+ * Short jobs over fixed size deques, one per thread. A thread pushes and
+ * pops at the back of its own deque, idle threads steal from the front of
+ * the others, so big batches submitted by one thread spread out on their
+ * own and nested jobs run close to where they were made.
+ *
+ * The deques are rings behind a mutex each, not lock-free Chase-Lev
+ * deques. The GL thread submits most jobs, so workers do meet on the lock
+ * of its queue, but it is held for copying one Job while a job culls and
+ * records hundreds of items. Lock-free deques would only pay off for much
+ * smaller jobs, at the price of far subtler memory ordering.
+ *
+ * Unlike ThreadPool there are no futures: jobs report through a
+ * JobCounter and the waiting thread runs jobs itself until the counter is
+ * done. Nothing allocates after construction, so it can run every frame.
+ */
+struct JobSystem {
+    // a full deque runs the job on the submitting thread instead
+    static const size_t QUEUE_CAPACITY = 4096;
+
+    struct Queue {
+        std::mutex mutex;
+        Job jobs[QUEUE_CAPACITY];
+        size_t front, size;  // ring of size jobs starting at front
+    };
+
+    // queues[0] belongs to threads that are not workers, e.g. the GL thread
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> queued;  // jobs in all queues, not yet started
+    std::atomic<bool> stopping;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<unsigned> steals;  // jobs taken from another queue
+
+    // threads including the caller, 0 uses every core
+    explicit JobSystem(unsigned threads = 0);
+    JobSystem(JobSystem const&) = delete;
+    JobSystem& operator=(JobSystem const&) = delete;
+    ~JobSystem();
+
+    // threads working on jobs while someone waits
+    size_t size() const { return workers.size() + 1; }
+
+    void submit(void (*run)(void* data, size_t index), void* data,
+                size_t index, JobCounter& counter);
+    // runs queued jobs, own first, until counter has finished
+    void wait(JobCounter& counter);
+
+    // f(begin, end) over [0, count) in ranges of batch, returns when done
+    template <typename F>
+    void parallel_for(size_t count, size_t batch, F const& f) {
+        struct Range {
+            F const* f;
+            size_t count, batch;
+        } range = {&f, count, batch};
+        JobCounter counter;
+        for (size_t begin = 0; begin < count; begin += batch)
+            submit(
+                [](void* data, size_t begin) {
+                    Range const& range = *(Range const*)data;
+                    (*range.f)(begin,
+                               std::min(begin + range.batch, range.count));
+                },
+                &range, begin, counter);
+        wait(counter);
+    }
+
+   private:
+    void run(size_t queue);
+    // pops from the back of queue or steals from the front of another one
+    bool try_run(size_t queue);
+    size_t own_queue() const;
+};
+
+#endif  // __JOB_SYSTEM_HPP
@@ -0,0 +1,347 @@
+#include "lod.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+
+LodView lod_view;
+
+void LodView::set(glm::vec3 eye, glm::mat4 const& projection) {
+    this->eye = eye;
+    projection_scale = std::fabs(projection[1][1]);
+    frame++;
+}
+
+int select_lod(int current, int count, float screen_size) {
+    int lod = std::min(std::max(current, 0), count - 1);
+    while (lod < count - 1 &&
+           screen_size < LOD_SCREEN_SIZES[lod] * (1 - LOD_HYSTERESIS))
+        lod++;
+    while (lod > 0 &&
+           screen_size > LOD_SCREEN_SIZES[lod - 1] * (1 + LOD_HYSTERESIS))
+        lod--;
+    return lod;
+}
+
+MeshData merge_lods(std::vector<MeshData> const& levels,
+                    std::vector<MeshLod>& ranges) {
+    MeshData merged;
+    ranges.clear();
+    for (MeshData const& level : levels) {
+        uint32_t base = merged.verticies.size();
+        ranges.push_back({(uint32_t)merged.indicies.size(),
+                          (uint32_t)level.indicies.size()});
+        merged.verticies.insert(merged.verticies.end(),
+                                level.verticies.begin(),
+                                level.verticies.end());
+        for (uint32_t i : level.indicies) merged.indicies.push_back(base + i);
+    }
+    return merged;
+}
+
+namespace {
+
+// weight of the planes holding open borders in place
+const double BORDER_WEIGHT = 100;
+// a collapse may turn a triangle normal by at most acos of this
+const float MIN_NORMAL_DOT = 0.2f;
+
+// symmetric 4x4 matrix of the summed squared plane distances
+struct Quadric {
+    double a[10];  // xx xy xz xw yy yz yw zz zw ww
+
+    void add_plane(glm::vec3 n, float d, double weight) {
+        double p[4] = {n.x, n.y, n.z, d};
+        int k = 0;
+        for (int i = 0; i < 4; i++)
+            for (int j = i; j < 4; j++) a[k++] += weight * p[i] * p[j];
+    }
+
+    void add(Quadric const& q) {
+        for (int k = 0; k < 10; k++) a[k] += q.a[k];
+    }
+
+    double error(glm::vec3 v) const {
+        double x = v.x, y = v.y, z = v.z;
+        return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z +
+               2 * a[3] * x + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y +
+               a[7] * z * z + 2 * a[8] * z + a[9];
+    }
+};
+
+struct Collapse {
+    double cost;
+    uint32_t from, to;  // positions, from moves onto to
+    unsigned from_version, to_version;
+
+    bool operator>(Collapse const& other) const { return cost > other.cost; }
+};
+
+struct Triangle {
+    uint32_t position[3];  // current position of each corner
+    uint32_t vertex[3];    // corner vertex in the source mesh
+    bool alive;
+};
+
+inline bool same_position(glm::vec3 a, glm::vec3 b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+inline bool position_less(glm::vec3 a, glm::vec3 b) {
+    if (a.x != b.x) return a.x < b.x;
+    if (a.y != b.y) return a.y < b.y;
+    return a.z < b.z;
+}
+
+}  // namespace
+
+MeshData simplify_mesh(MeshData const& mesh, size_t target_triangles) {
+    std::vector<Vertex> const& verticies = mesh.verticies;
+    size_t triangle_count = mesh.indicies.size() / 3;
+    if (triangle_count <= target_triangles) return mesh;
+
+    // weld verticies by exact position
+    std::vector<uint32_t> order(verticies.size());
+    for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return position_less(verticies[a].position, verticies[b].position);
+    });
+    std::vector<uint32_t> position_of(verticies.size());
+    std::vector<glm::vec3> points;
+    std::vector<std::vector<uint32_t>> verticies_at;
+    for (size_t i = 0; i < order.size(); i++) {
+        glm::vec3 p = verticies[order[i]].position;
+        if (points.empty() || !same_position(points.back(), p)) {
+            points.push_back(p);
+            verticies_at.emplace_back();
+        }
+        position_of[order[i]] = points.size() - 1;
+        verticies_at.back().push_back(order[i]);
+    }
+
+    std::vector<Triangle> triangles(triangle_count);
+    std::vector<std::vector<uint32_t>> triangles_at(points.size());
+    std::vector<Quadric> quadrics(points.size(), Quadric{});
+    for (size_t t = 0; t < triangle_count; t++) {
+        Triangle& tri = triangles[t];
+        for (int k = 0; k < 3; k++) {
+            tri.vertex[k] = mesh.indicies[t * 3 + k];
+            tri.position[k] = position_of[tri.vertex[k]];
+            triangles_at[tri.position[k]].push_back(t);
+        }
+        tri.alive = true;
+
+        glm::vec3 a = points[tri.position[0]], b = points[tri.position[1]],
+                  c = points[tri.position[2]];
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        if (length == 0) continue;
+        n = n / length;
+        for (int k = 0; k < 3; k++)
+            quadrics[tri.position[k]].add_plane(n, -glm::dot(n, a),
+                                                length / 2);
+    }
+
+    // edges used by a single triangle are borders, a plane through each
+    // border, perpendicular to its triangle, keeps it from moving inwards
+    std::vector<std::pair<uint64_t, uint32_t>> edges;
+    for (uint32_t t = 0; t < triangle_count; t++)
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = triangles[t].position[k],
+                     b = triangles[t].position[(k + 1) % 3];
+            if (a > b) std::swap(a, b);
+            edges.push_back({(uint64_t)a << 32 | b, t});
+        }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();) {
+        size_t j = i;
+        while (j < edges.size() && edges[j].first == edges[i].first) j++;
+        if (j - i == 1) {
+            uint32_t a = edges[i].first >> 32, b = (uint32_t)edges[i].first;
+            Triangle const& tri = triangles[edges[i].second];
+            glm::vec3 n = glm::cross(points[tri.position[1]] -
+                                         points[tri.position[0]],
+                                     points[tri.position[2]] -
+                                         points[tri.position[0]]);
+            glm::vec3 e = points[b] - points[a];
+            glm::vec3 border = glm::cross(e, n);
+            float length = glm::length(border);
+            if (length > 0) {
+                border = border / length;
+                double weight = BORDER_WEIGHT * glm::dot(e, e);
+                float d = -glm::dot(border, points[a]);
+                quadrics[a].add_plane(border, d, weight);
+                quadrics[b].add_plane(border, d, weight);
+            }
+        }
+        i = j;
+    }
+
+    std::vector<unsigned> version(points.size(), 0);
+    std::vector<bool> removed(points.size(), false);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> heap;
+    auto push_edge = [&](uint32_t a, uint32_t b) {
+        Quadric q = quadrics[a];
+        q.add(quadrics[b]);
+        double to_b = q.error(points[b]), to_a = q.error(points[a]);
+        if (to_b <= to_a)
+            heap.push({to_b, a, b, version[a], version[b]});
+        else
+            heap.push({to_a, b, a, version[b], version[a]});
+    };
+    for (size_t i = 0; i < edges.size(); i++)
+        if (!i || edges[i].first != edges[i - 1].first)
+            push_edge(edges[i].first >> 32, (uint32_t)edges[i].first);
+
+    size_t alive = triangle_count;
+    while (alive > target_triangles && !heap.empty()) {
+        Collapse c = heap.top();
+        heap.pop();
+        if (removed[c.from] || removed[c.to] ||
+            version[c.from] != c.from_version ||
+            version[c.to] != c.to_version)
+            continue;
+
+        // moving from onto to must not fold any surviving triangle over
+        bool flips = false;
+        for (uint32_t t : triangles_at[c.from]) {
+            Triangle const& tri = triangles[t];
+            if (!tri.alive) continue;
+            glm::vec3 p[3], q[3];
+            bool collapses = false;
+            for (int k = 0; k < 3; k++) {
+                p[k] = q[k] = points[tri.position[k]];
+                if (tri.position[k] == c.from) q[k] = points[c.to];
+                collapses |= tri.position[k] == c.to;
+            }
+            if (collapses) continue;
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            float lengths = glm::length(before) * glm::length(after);
+            if (lengths == 0 ||
+                glm::dot(before, after) < MIN_NORMAL_DOT * lengths) {
+                flips = true;
+                break;
+            }
+        }
+        if (flips) continue;
+
+        removed[c.from] = true;
+        quadrics[c.to].add(quadrics[c.from]);
+        version[c.to]++;
+        for (uint32_t t : triangles_at[c.from]) {
+            Triangle& tri = triangles[t];
+            if (!tri.alive) continue;
+            bool collapses = false;
+            for (int k = 0; k < 3; k++) {
+                collapses |= tri.position[k] == c.to;
+                if (tri.position[k] == c.from) tri.position[k] = c.to;
+            }
+            if (collapses) {
+                tri.alive = false;
+                alive--;
+            } else {
+                triangles_at[c.to].push_back(t);
+            }
+        }
+
+        // costs around the merged position changed
+        for (uint32_t t : triangles_at[c.to]) {
+            Triangle const& tri = triangles[t];
+            if (!tri.alive) continue;
+            for (int k = 0; k < 3; k++)
+                if (tri.position[k] != c.to) push_edge(c.to, tri.position[k]);
+        }
+    }
+
+    // corners take the vertex at their final position closest in normal
+    MeshData output;
+    std::vector<uint32_t> remap(verticies.size(), UINT32_MAX);
+    for (Triangle const& tri : triangles) {
+        if (!tri.alive) continue;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = tri.vertex[k];
+            if (position_of[v] != tri.position[k]) {
+                uint32_t best = verticies_at[tri.position[k]][0];
+                float best_dot = -2;
+                for (uint32_t candidate : verticies_at[tri.position[k]]) {
+                    float d = glm::dot(verticies[candidate].normal,
+                                       verticies[v].normal);
+                    if (d > best_dot) best_dot = d, best = candidate;
+                }
+                v = best;
+            }
+            if (remap[v] == UINT32_MAX) {
+                remap[v] = output.verticies.size();
+                output.verticies.push_back(verticies[v]);
+            }
+            output.indicies.push_back(remap[v]);
+        }
+    }
+    return output;
+}
+
+std::vector<MeshData> build_mesh_lods(MeshData&& mesh) {
+    std::vector<MeshData> levels;
+    levels.push_back(std::move(mesh));
+    size_t full = levels[0].indicies.size() / 3;
+    for (int i = 1; i < MAX_LODS; i++) {
+        MeshData level = simplify_mesh(levels[0], full >> i);
+        // a level that barely shrinks costs memory and buys nothing
+        if (level.indicies.size() * 4 > levels.back().indicies.size() * 3)
+            break;
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
+
+VoxModel downsample_voxels(VoxModel const& model, int factor) {
+    VoxModel out;
+    out.size = {(model.size.x + factor - 1) / factor,
+                (model.size.y + factor - 1) / factor,
+                (model.size.z + factor - 1) / factor};
+    out.voxels.assign(out.size.x * out.size.y * out.size.z, 0);
+    memcpy(out.palette, model.palette, sizeof(out.palette));
+    out.has_palette = model.has_palette;
+
+    for (int z = 0; z < out.size.z; z++)
+        for (int y = 0; y < out.size.y; y++)
+            for (int x = 0; x < out.size.x; x++) {
+                int counts[256] = {};
+                int best = 0;
+                for (int k = 0; k < factor; k++)
+                    for (int j = 0; j < factor; j++)
+                        for (int i = 0; i < factor; i++) {
+                            uint8_t c = model.at(x * factor + i,
+                                                 y * factor + j,
+                                                 z * factor + k);
+                            if (!c) continue;
+                            counts[c]++;
+                            if (counts[c] > counts[best]) best = c;
+                        }
+                out.voxels[x + out.size.x * (y + out.size.y * z)] = best;
+            }
+    return out;
+}
+
+std::vector<MeshData> build_vox_lods(VoxModel const& model) {
+    std::vector<MeshData> levels;
+    levels.push_back(greedy_mesh_voxels(model));
+
+    // same pivot as the full model, in coarse cells
+    glm::vec3 pivot = {(float)(model.size.x / 2), (float)(model.size.y / 2),
+                       0.0f};
+    auto rotate = [](glm::vec3 v) { return glm::vec3{-v.y, v.z, -v.x}; };
+    for (int i = 1, factor = 2; i < MAX_LODS; i++, factor *= 2) {
+        VoxModel coarse = downsample_voxels(model, factor);
+        MeshData level;
+        greedy_mesh_region(
+            [&](int x, int y, int z) { return coarse.at(x, y, z); },
+            glm::ivec3(0), coarse.size, pivot / (float)factor, rotate,
+            VOX_SCALE * factor, level);
+        if (level.indicies.size() >= levels.back().indicies.size()) break;
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
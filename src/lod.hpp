@@ -0,0 +1,61 @@
+#ifndef __LOD_HPP
+#define __LOD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "vertex.hpp"
+#include "vox.hpp"
+
+const int MAX_LODS = 3;
+// a level is left for the next once its screen size falls below this, as a
+// fraction of half the screen height
+const float LOD_SCREEN_SIZES[MAX_LODS - 1] = {0.3f, 0.12f};
+// switching needs this much beyond the threshold, so meshes sitting right
+// at it don't pop back and forth
+const float LOD_HYSTERESIS = 0.15f;
+
+// range of one level in the index buffer shared by all levels
+struct MeshLod {
+    uint32_t first_index, index_count;
+};
+
+// camera LODs are chosen for, set once per frame
+struct LodView {
+    glm::vec3 eye;
+    float projection_scale;  // projection[1][1], world size to screen size
+    unsigned frame;          // bumped by set()
+
+    void set(glm::vec3 eye, glm::mat4 const& projection);
+};
+
+extern LodView lod_view;
+
+// next level for a mesh at current level covering screen_size
+int select_lod(int current, int count, float screen_size);
+
+// levels appended into one mesh, indicies rebased onto the merged verticies
+MeshData merge_lods(std::vector<MeshData> const& levels,
+                    std::vector<MeshLod>& ranges);
+
+/*
+ * Quadric error edge collapse (Garland and Heckbert) down to at most
+ * target_triangles. Verticies sharing a position collapse together and
+ * a collapsed corner takes the vertex of the surviving position with the
+ * closest normal, so attribute seams stay sharp. Collapses flipping a
+ * triangle are skipped and open borders are held by extra planes.
+ */
+MeshData simplify_mesh(MeshData const& mesh, size_t target_triangles);
+// full detail followed by simplified halvings, while they still pay off
+std::vector<MeshData> build_mesh_lods(MeshData&& mesh);
+
+// a cell is solid if any of its factor^3 cells is, with the most common
+// color among them, so thin parts don't vanish
+VoxModel downsample_voxels(VoxModel const& model, int factor);
+// greedy meshes at full, half and quarter resolution, placed like
+// greedy_mesh_voxels() so all levels stay on the VOX_SCALE grid
+std::vector<MeshData> build_vox_lods(VoxModel const& model);
+
+#endif  // __LOD_HPP
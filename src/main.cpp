@@ -3,23 +3,48 @@
 #define __ __
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <glm/common.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_access.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <memory>
 #include <vector>
 
+#include "alloc_counter.hpp"
+#include "arena.hpp"
+#include "asset_manager.hpp"
+#include "camera_path.hpp"
+#include "chunk_mesher.hpp"
+#include "frame_data.hpp"
+#include "instancing.hpp"
+#include "job_system.hpp"
+#include "lod.hpp"
 #include "mesh.hpp"
+#include "occlusion.hpp"
+#include "profiler.hpp"
+#include "render_queue.hpp"
+#include "scene_graph.hpp"
+#include "shader_manager.hpp"
+#include "shadows.hpp"
+#include "simulation.hpp"
+#include "stream_buffer.hpp"
+#include "texture_manager.hpp"
 #include "util.hpp"
 #include "vertex.hpp"
+#include "voxel_world.hpp"
 
 struct InputState {
     bool up, down, left, right;
+    bool dig, build;  // pressed since the last frame
     glm::vec2 last_mouse, mouse, mouse_delta;
     void update() {
         mouse_delta = mouse - last_mouse;
@@ -31,8 +56,20 @@ const float PI = 3.1415926536;
 
 const glm::vec2 SCREEN_SIZE = {1200, 800};
 
-const float SUN_VIEW_SIZE = 8;
-const int SUN_TEX_SIZE = 1024;
+const glm::vec3 X_AXIS = {1, 0, 0};
+const glm::vec3 Y_AXIS = {0, 1, 0};
+// camera space, lower right of the view
+const glm::vec3 SHOTGUN_OFFSET = {0.8f, -0.6f, -1.f};
+
+const glm::vec3 SUN_DIRECTION =
+    glm::normalize(glm::vec3{-0.5f, -0.7071f, -0.5f});
+const int SHADOW_TEX_SIZE = 1024;
+const float SHADOW_DISTANCE = 60;
+// glPolygonOffset of the shadow pass, replaces a depth bias in shaders
+const float SHADOW_OFFSET_FACTOR = 2.f;
+const float SHADOW_OFFSET_UNITS = 4.f;
+// shadow casters are drawn this many levels of detail coarser
+const int SHADOW_LOD_BIAS = 1;
 
 const glm::mat4 PLAYER_CAMERA_PROJECTION =
     glm::perspective(45.f, SCREEN_SIZE.x / SCREEN_SIZE.y, 0.01f, 1000.f);
@@ -45,10 +82,6 @@ struct Camera {
     // projection
     glm::mat4 projection;
 
-    // movement thingies
-    float speed;
-    float sensitivity;
-
     // framebuffer thingies
     GLuint fbo;
     GLuint color_tex;
@@ -60,8 +93,6 @@ struct Camera {
         : projection(projection), view_w(w), view_h(h) {
         position = {0, 1, 10};
         pitch = yaw = 0;
-        speed = 10;
-        sensitivity = 0.01f;
     }
 
     void init_fbo() {
@@ -122,6 +153,11 @@ struct Camera {
 
     void unbind_fbo() { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
 
+    glm::vec3 get_forward() {
+        return {-glm::sin(yaw) * glm::cos(pitch), glm::sin(pitch),
+                -glm::cos(yaw) * glm::cos(pitch)};
+    }
+
     glm::mat4 get_view_mat() {
         glm::mat4 view(1.0f);
         view = glm::rotate(view, -pitch, {1, 0, 0});
@@ -130,18 +166,6 @@ struct Camera {
         return view;
     }
 
-    void update(float dt) {
-        glm::vec3 fd = {glm::sin(yaw), 0, glm::cos(yaw)};
-        glm::vec3 rt = glm::cross({0, 1, 0}, fd);
-        if (input_state.up) position -= fd * speed * dt;
-        if (input_state.down) position += fd * speed * dt;
-        if (input_state.left) position -= rt * speed * dt;
-        if (input_state.right) position += rt * speed * dt;
-        yaw -= input_state.mouse_delta.x * sensitivity;
-        pitch -= input_state.mouse_delta.y * sensitivity;
-        pitch = glm::clamp(pitch, -PI / 4, PI / 4);
-    }
-
     ~Camera() {
         glDeleteTextures(1, &color_tex);
         glDeleteTextures(1, &depth_tex);
@@ -171,6 +195,12 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action,
         case GLFW_KEY_RIGHT:
             input_state.right = pressed;
             break;
+        case GLFW_KEY_F:
+            input_state.dig |= pressed;
+            break;
+        case GLFW_KEY_G:
+            input_state.build |= pressed;
+            break;
     }
 }
 
@@ -179,13 +209,164 @@ void mouse_pos_callback(GLFWwindow* window, double xpos, double ypos) {
     input_state.mouse.y = ypos;
 }
 
+void push_stress_scene(RenderQueue& queue, InstancedMesh& instanced,
+                       std::vector<std::unique_ptr<Mesh>>& naive) {
+    if (!naive.empty()) {
+        for (auto& mesh : naive) queue.push(mesh.get());
+    } else if (!instanced.instances.empty()) {
+        queue.push(&instanced);
+    }
+}
+
+// world space bounding box of mesh as 12 lines
+void push_bounds(StreamBuffer& stream, Mesh const& mesh, uint32_t color) {
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 local = {i & 1 ? mesh.bounds.max.x : mesh.bounds.min.x,
+                           i & 2 ? mesh.bounds.max.y : mesh.bounds.min.y,
+                           i & 4 ? mesh.bounds.max.z : mesh.bounds.min.z, 1};
+        corners[i] = glm::vec3(mesh.model * local);
+    }
+    // corners differing in one bit share an edge
+    for (int i = 0; i < 8; i++)
+        for (int bit = 1; bit < 8; bit <<= 1)
+            if (!(i & bit))
+                stream.push_line(corners[i], corners[i | bit], color);
+}
+
+// octahedron of 8 triangles around center
+void push_marker(StreamBuffer& stream, glm::vec3 center, float size,
+                 uint32_t color) {
+    StreamVertex triangles[24];
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 x = {i & 1 ? size : -size, 0, 0};
+        glm::vec3 y = {0, i & 2 ? size : -size, 0};
+        glm::vec3 z = {0, 0, i & 4 ? size : -size};
+        triangles[i * 3] = {center + x, color};
+        triangles[i * 3 + 1] = {center + y, color};
+        triangles[i * 3 + 2] = {center + z, color};
+    }
+    stream.push_triangles(triangles, 24);
+}
+
+struct Options {
+    int stress_count;             // wands in the stress scene, 0 for none
+    bool stress_naive;            // stress wands drawn one by one
+    const char* trace_path;       // Chrome trace written on exit
+    bool headless;                // invisible window, camera path playback
+    bool osmesa;                  // OSMesa context instead of the native one
+    int frames;                   // frames rendered when headless
+    const char* camera_path;      // replayed when headless
+    const char* record_path;      // camera path recorded while playing
+    const char* screenshot_path;  // PNG of the last frame
+    bool shadow_cull_front;       // cull front faces when rendering shadows
+    bool check_allocs;            // fail if steady frames touch the heap
+    bool voxel_world;             // editable terrain under the scene
+    bool debug_draw;              // bounding boxes and the edit target
+    bool occlusion_cull;          // skip what earlier camera depth hides
+};
+
+// GL data uploaded per frame once assets arrive from the workers
+const size_t UPLOAD_BUDGET = 4 << 20;
+
+// chunk meshes swapped in per frame, each re-fills its GL buffers
+const int MAX_CHUNK_SWAPS = 8;
+// cells of the terrain, 0.25 units each
+const glm::ivec3 TERRAIN_MIN = {-96, -48, -96};
+const glm::ivec3 TERRAIN_MAX = {96, -8, 96};
+const float EDIT_RADIUS = 1.f;
+const float EDIT_REACH = 30.f;
+
+// frames before heap allocations are counted, caches and arenas settle
+const int ALLOC_WARMUP_FRAMES = 10;
+
+const int HEADLESS_FRAMES = 600;
+// a headless frame is one simulation tick
+const float HEADLESS_DT = SIM_TICK;
+
+Options parse_options(int argc, char** argv) {
+    Options options = {};
+    options.frames = HEADLESS_FRAMES;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : 0;
+        int count = value ? atoi(value) : 0;
+
+        if (!strcmp(arg, "--stress") || !strcmp(arg, "--stress-naive")) {
+            options.stress_naive = !strcmp(arg, "--stress-naive");
+            options.stress_count = 10000;
+            if (count > 0) options.stress_count = count, i++;
+        } else if (!strcmp(arg, "--headless")) {
+            options.headless = true;
+        } else if (!strcmp(arg, "--osmesa")) {
+            options.headless = options.osmesa = true;
+        } else if (!strcmp(arg, "--shadow-cull-front")) {
+            options.shadow_cull_front = true;
+        } else if (!strcmp(arg, "--check-allocs")) {
+            options.check_allocs = true;
+        } else if (!strcmp(arg, "--voxel-world")) {
+            options.voxel_world = true;
+        } else if (!strcmp(arg, "--debug-draw")) {
+            options.debug_draw = true;
+        } else if (!strcmp(arg, "--occlusion-cull")) {
+            options.occlusion_cull = true;
+        } else if (!strcmp(arg, "--frames") && count > 0) {
+            options.frames = count, i++;
+        } else if (!strcmp(arg, "--trace") && value) {
+            options.trace_path = value, i++;
+        } else if (!strcmp(arg, "--camera-path") && value) {
+            options.camera_path = value, i++;
+        } else if (!strcmp(arg, "--record-path") && value) {
+            options.record_path = value, i++;
+        } else if (!strcmp(arg, "--screenshot") && value) {
+            options.screenshot_path = value, i++;
+        } else {
+            std::cerr << "[ERROR] Unknown option: " << arg << std::endl;
+            std::cerr << "usage: game [--stress [N]] [--stress-naive [N]]"
+                         " [--trace FILE]\n"
+                         "            [--headless] [--osmesa] [--frames N]"
+                         " [--camera-path FILE]\n"
+                         "            [--record-path FILE]"
+                         " [--screenshot FILE.png] [--shadow-cull-front]\n"
+                         "            [--check-allocs] [--voxel-world]"
+                         " [--debug-draw] [--occlusion-cull]"
+                      << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    return options;
+}
+
+// reads back the color attachment, top row first
+void save_screenshot(Camera const& camera, const char* filename) {
+    std::vector<uint8_t> pixels(camera.view_w * camera.view_h * 4);
+    glBindTexture(GL_TEXTURE_2D, camera.color_tex);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    size_t row_size = camera.view_w * 4;
+    for (unsigned y = 0; y < camera.view_h / 2; y++)
+        std::swap_ranges(pixels.begin() + y * row_size,
+                         pixels.begin() + (y + 1) * row_size,
+                         pixels.begin() + (camera.view_h - 1 - y) * row_size);
+
+    if (write_png_file(filename, pixels.data(), camera.view_w, camera.view_h))
+        std::cout << "[INFO] Saved screenshot to " << filename << std::endl;
+}
+
 void error_callback(int code, const char* msg) {
     std::cerr << "[ERROR] " << msg << std::endl;
 }
 
-int main() {
+int main(int argc, char** argv) {
     // Starting
     std::cout << "[INFO] Starting..." << std::endl;
+    std::chrono::high_resolution_clock::time_point startup_time =
+        std::chrono::high_resolution_clock::now();
+
+    Options options = parse_options(argc, argv);
 
     GLFWwindow* window;
 
@@ -206,6 +387,14 @@ int main() {
     glfwWindowHint(GLFW_FLOATING, GLFW_TRUE);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
+    // Headless renders into the camera framebuffer of a hidden window
+    if (options.headless) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_FLOATING, GLFW_FALSE);
+    }
+    if (options.osmesa)
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+
     // Create window
     window =
         glfwCreateWindow(SCREEN_SIZE.x, SCREEN_SIZE.y, "Hello", NULL, NULL);
@@ -216,12 +405,14 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
-    // input settings
-    glfwSetKeyCallback(window, key_callback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    if (glfwRawMouseMotionSupported())
-        glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
-    glfwSetCursorPosCallback(window, mouse_pos_callback);
+    // input settings, headless is driven by the camera path only
+    if (!options.headless) {
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        if (glfwRawMouseMotionSupported())
+            glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+        glfwSetCursorPosCallback(window, mouse_pos_callback);
+    }
     // Set created window as current context
     glfwMakeContextCurrent(window);
 
@@ -233,15 +424,20 @@ int main() {
 
     //////////////////////////////////////// GL PROCEDURES LOADED
 
+    // Initialize per pass uniform buffer
+    frame_uniforms.init();
+
+    // Initialize texture manager and its palette array
+    texture_manager.init();
+
+    profiler.init(options.trace_path != 0);
+
     // Initialize player camera framebuffer
     player_camera.init_fbo();
 
-    glm::mat4 sun_projection =
-        glm::ortho(-SUN_VIEW_SIZE, SUN_VIEW_SIZE, -SUN_VIEW_SIZE, SUN_VIEW_SIZE,
-                   0.0f, 1000.f);
-    Camera sun(sun_projection, SUN_TEX_SIZE, SUN_TEX_SIZE);
-
-    sun.init_fbo();
+    // Initialize sun shadow maps
+    ShadowCascades shadows;
+    shadows.init(SHADOW_TEX_SIZE, SHADOW_DISTANCE);
 
     // Print out some info about renderer
     std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
@@ -250,33 +446,59 @@ int main() {
     std::cout << "Vendor: " << glGetString(GL_VENDOR) << std::endl;
     std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
 
-    // Load shaders
+    // Load shaders, stages are compiled once and programs come from the
+    // binary cache when the driver supports it
     std::cout << "[INFO] Loading shaders..." << std::endl;
+    std::chrono::high_resolution_clock::time_point shaders_start =
+        std::chrono::high_resolution_clock::now();
 
-    std::string vertex_shader = load_whole_file("shaders/standard.vs");
-    std::string uvcolor_fragment_shader = load_whole_file("shaders/uvcolor.fs");
-    std::string gray_frament_shader = load_whole_file("shaders/gray.fs");
-    std::string textured_frament_shader =
-        load_whole_file("shaders/textured.fs");
-    std::string screen_frament_shader =
-        load_whole_file("shaders/textured_unlit.fs");
-
-    std::cout << "[INFO] Finished loading shaders!" << std::endl;
-
-    // Creating shader program
+    shader_manager.init((GLADloadproc)glfwGetProcAddress);
     GLuint uvcolor_glprog =
-        create_shader_program(vertex_shader, uvcolor_fragment_shader);
+        shader_manager.get("shaders/standard.vs", "shaders/uvcolor.fs");
     GLuint gray_glprog =
-        create_shader_program(vertex_shader, gray_frament_shader);
-    GLuint textured_glprog =
-        create_shader_program(vertex_shader, textured_frament_shader);
+        shader_manager.get("shaders/standard.vs", "shaders/gray.fs");
     GLuint screen_glprog =
-        create_shader_program(vertex_shader, screen_frament_shader);
-
-    // Load palette texture for textured
-    GLuint palette_texture = load_texture_file("assets/wand.png");
-    GLuint tex_uniform_id = glGetUniformLocation(textured_glprog, "tex");
-    glUniform1ui(tex_uniform_id, palette_texture);
+        shader_manager.get("shaders/standard.vs", "shaders/textured_unlit.fs");
+    GLuint voxel_glprog =
+        shader_manager.get("shaders/voxel.vs", "shaders/voxel.fs");
+    GLuint voxel_instanced_glprog =
+        shader_manager.get("shaders/voxel_instanced.vs", "shaders/voxel.fs");
+    GLuint shadow_glprog =
+        shader_manager.get("shaders/shadow.vs", "shaders/shadow.fs");
+    GLuint shadow_instanced_glprog =
+        shader_manager.get("shaders/shadow_instanced.vs", "shaders/shadow.fs");
+    GLuint stream_glprog =
+        shader_manager.get("shaders/stream.vs", "shaders/stream.fs");
+    GLuint hiz_glprog =
+        shader_manager.get("shaders/hiz.vs", "shaders/hiz.fs");
+    if (!options.headless) shader_manager.watch("shaders");
+
+    std::cout << "[INFO] Finished loading shaders in "
+              << std::chrono::duration<float, std::milli>(
+                     std::chrono::high_resolution_clock::now() -
+                     shaders_start)
+                     .count()
+              << " ms (" << shader_manager.programs.size() << " programs, "
+              << shader_manager.compiled_stages << " stages compiled, "
+              << shader_manager.binary_hits << " from cache)" << std::endl;
+
+    // Initialize per frame geometry streaming
+    StreamBuffer stream_buffer;
+    stream_buffer.init(stream_glprog);
+
+    // Initialize the camera depth pyramid for occlusion culling
+    HiZBuffer hiz;
+    hiz.init(hiz_glprog, player_camera.view_w, player_camera.view_h);
+
+    // Start loading assets, placeholders are drawn until they arrive
+    AssetManager assets;
+    std::cout << "[INFO] Loading assets on " << assets.pool.size()
+              << " threads" << std::endl;
+
+    // Load palettes, all voxel meshes share the array they are layers of
+    GLuint palette_array = texture_manager.palette_array;
+    int wand_palette = assets.load_palette("assets/wand.png");
+    int shotgun_palette = assets.load_palette("assets/shotgun.png");
 
     // Create quad mesh
     Mesh quad_mesh = Mesh::create_quad({-1.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 0.0f},
@@ -294,12 +516,64 @@ int main() {
     Mesh cube_mesh = Mesh::create_cube({3, 0.5, 0}, 1, uvcolor_glprog);
 
     // Create voxel mesh
-    Mesh wand_mesh = Mesh::create_from_obj("assets/wand.obj", textured_glprog,
-                                           palette_texture);
+    Mesh wand_mesh =
+        Mesh::create_placeholder(voxel_glprog, palette_array, true);
+    wand_mesh.palette_layer = wand_palette;
+    assets.load_mesh("assets/wand.vox", &wand_mesh);
 
     // Create shotgun mesh
-    Mesh shotgun_mesh = Mesh::create_from_obj("assets/shotgun.obj",
-                                              textured_glprog, palette_texture);
+    Mesh shotgun_mesh =
+        Mesh::create_placeholder(voxel_glprog, palette_array, true);
+    shotgun_mesh.palette_layer = shotgun_palette;
+    assets.load_mesh("assets/shotgun.vox", &shotgun_mesh);
+
+    // Transform hierarchy, the shotgun is held in front of the camera
+    SceneGraph scene;
+    uint32_t wand_node = scene.add();
+    uint32_t camera_node = scene.add();
+    uint32_t shotgun_node = scene.add(camera_node);
+    scene.set_local(shotgun_node, SHOTGUN_OFFSET,
+                    glm::angleAxis(-PI / 2, X_AXIS), glm::vec3(0.8f));
+
+    // Create stress scene, a grid of wands drawn with one instanced call
+    InstancedMesh stress_wands(&wand_mesh, voxel_instanced_glprog);
+    std::vector<std::unique_ptr<Mesh>> naive_wands;
+    if (options.stress_count) {
+        int side = (int)std::ceil(std::sqrt((float)options.stress_count));
+        for (int i = 0; i < options.stress_count; i++) {
+            glm::vec3 pos = {(i % side - side / 2) * 1.5f, 0,
+                             -(i / side) * 1.5f - 12.f};
+            stress_wands.add(glm::translate(glm::mat4(1), pos));
+        }
+        stress_wands.upload();
+
+        if (options.stress_naive) {
+            // baseline: a mesh with its own buffers per copy
+            naive_wands.reserve(options.stress_count);
+            for (int i = 0; i < options.stress_count; i++) {
+                naive_wands.emplace_back(new Mesh(Mesh::create_from_vox(
+                    "assets/wand.vox", voxel_glprog, palette_array)));
+                naive_wands.back()->palette_layer = wand_palette;
+                naive_wands.back()->model = stress_wands.instances[i].model;
+            }
+        }
+        std::cout << "[INFO] Stress scene: " << options.stress_count
+                  << " wands ("
+                  << (options.stress_naive ? "one draw each" : "instanced")
+                  << ")" << std::endl;
+    }
+
+    // Create voxel terrain, chunks are meshed on the asset workers
+    VoxelWorld voxel_world;
+    ChunkMesher chunk_mesher(voxel_world, assets.pool, voxel_glprog,
+                             palette_array, wand_palette);
+    if (options.voxel_world) {
+        voxel_world.generate_terrain(TERRAIN_MIN, TERRAIN_MAX);
+        std::cout << "[INFO] Voxel world: " << voxel_world.chunks.size()
+                  << " chunks, F digs and G builds where you look"
+                  << std::endl;
+    }
+
     // Create screen quad mesh
     Mesh screen_quad_mesh = Mesh::create_quad(
         {-1.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 0.0f}, {1.0f, -1.0f, 0.0f},
@@ -311,13 +585,53 @@ int main() {
 
     float time_since_last_fps_count = 0;
     int frames = 0;
-    float rotation = 0;
+
+    CullStats sun_cull = {}, camera_cull = {};
+
+    // Passes are recorded on every core, the GL thread only replays them
+    JobSystem jobs;
+    CommandBuffer cascade_commands[SHADOW_CASCADES], camera_commands,
+        overlay_commands;
+    std::cout << "[INFO] Recording passes on " << jobs.size() << " threads"
+              << std::endl;
+
+    // Headless replays a camera path with a fixed dt
+    CameraPath camera_path, recorded_path;
+    if (options.headless && options.camera_path) {
+        if (!camera_path.load(options.camera_path)) exit(EXIT_FAILURE);
+    } else if (options.headless) {
+        camera_path =
+            CameraPath::orbit(10, 2, HEADLESS_FRAMES * HEADLESS_DT);
+    }
+
+    // Movement runs at a fixed tick, on its own thread unless headless
+    Simulation simulation;
+    if (options.headless) simulation.path = &camera_path;
+    if (options.record_path) simulation.record = &recorded_path;
+    SimState initial = {};
+    initial.camera_position = player_camera.position;
+    initial.camera_pitch = player_camera.pitch;
+    initial.camera_yaw = player_camera.yaw;
+    simulation.reset(initial);
+    if (!options.headless) simulation.start();
+
+    int frame_count = 0;
+    bool assets_loaded = false;
+    uint64_t steady_allocations = 0;
+
+    // Headless runs are compared frame by frame, so no placeholders there
+    if (options.headless) {
+        assets.finish();
+        chunk_mesher.finish();
+    }
+    std::chrono::high_resolution_clock::time_point start_time = last_time;
 
     // Enable face culling
     /* glEnable(GL_CULL_FACE); */
 
     // Main loop
-    while (!glfwWindowShouldClose(window)) {
+    while (!glfwWindowShouldClose(window) &&
+           !(options.headless && frame_count == options.frames)) {
         // dt calculation
         std::chrono::high_resolution_clock::time_point now_time =
             std::chrono::high_resolution_clock::now();
@@ -326,104 +640,289 @@ int main() {
                 .count() /
             1000;
         last_time = now_time;
+        if (options.headless) dt = HEADLESS_DT;
+        uint64_t frame_start_allocations = heap_allocations;
 
         // fps display
         frames++;
         time_since_last_fps_count += dt;
-        if (time_since_last_fps_count >= 3) {
+        if (!options.headless && time_since_last_fps_count >= 3) {
             char buff[255];
             float fps = frames / time_since_last_fps_count;
             sprintf(buff, "Hello (fps: %.1f)", fps);
             glfwSetWindowTitle(window, buff);
+            std::cout << "[INFO] Last frame: " << render_stats.draw_calls
+                      << " draws, " << render_stats.triangles
+                      << " triangles, " << render_stats.state_changes()
+                      << " state changes (programs: "
+                      << render_stats.program_binds
+                      << ", textures: " << render_stats.texture_binds
+                      << " (" << render_stats.palette_switches
+                      << " palette switches without one)"
+                      << ", vaos: " << render_stats.vao_binds
+                      << ", uniforms: " << render_stats.uniform_uploads << ")"
+                      << std::endl;
+            std::cout << "[INFO] Culling: sun " << sun_cull.visible
+                      << " visible / " << sun_cull.culled << " culled, camera "
+                      << camera_cull.visible << " visible / "
+                      << camera_cull.culled << " culled / "
+                      << camera_cull.occluded << " occluded" << std::endl;
+            profiler.print_summary(std::cout);
+            simulation.print_summary(std::cout);
             time_since_last_fps_count = 0;
             frames = 0;
         }
 
-        // input
+        // everything drawn from the frame arena last frame is gone now
+        frame_arena.reset();
+        RenderQueue render_queue, overlay_queue;
+
+        render_stats.reset();
+        shader_manager.poll();
+        frame_uniforms.begin_frame();
+        stream_buffer.begin_frame();
+        profiler.begin_frame();
+        ProfileScope frame_scope("frame");
+
+        profiler.begin("uploads", true);
+        assets.process_uploads(UPLOAD_BUDGET);
+        chunk_mesher.update(MAX_CHUNK_SWAPS);
+        if (!assets_loaded && assets.idle()) {
+            assets_loaded = true;
+            std::cout << "[INFO] Assets loaded after "
+                      << std::chrono::duration<float, std::milli>(
+                             std::chrono::high_resolution_clock::now() -
+                             startup_time)
+                             .count()
+                      << " ms" << std::endl;
+            texture_manager.print_summary(std::cout);
+        }
+        profiler.end();
+
+        profiler.begin("update", false);
+        // input, taken by the next tick
         input_state.update();
+        simulation.set_input(input_state.up, input_state.down,
+                             input_state.left, input_state.right,
+                             input_state.mouse_delta);
+
+        // updating, headless frames are exactly one tick each
+        if (options.headless) simulation.step();
+        SimState sim = simulation.sample(Simulation::Clock::now());
+        player_camera.position = sim.camera_position;
+        player_camera.pitch = sim.camera_pitch;
+        player_camera.yaw = sim.camera_yaw;
+
+        // edits only dirty chunks, they are remeshed over the next frames
+        if (input_state.dig || input_state.build) {
+            glm::vec3 forward = player_camera.get_forward();
+            glm::vec3 hit;
+            if (voxel_world.raycast(player_camera.position, forward,
+                                    EDIT_REACH, hit)) {
+                if (input_state.dig)
+                    voxel_world.fill_sphere(hit, EDIT_RADIUS, 0);
+                else
+                    voxel_world.fill_sphere(hit - forward * EDIT_RADIUS,
+                                            EDIT_RADIUS, 20);
+            }
+            input_state.dig = input_state.build = false;
+        }
 
-        // updating
-        player_camera.update(dt);
-
-        sun.position = player_camera.position + glm::vec3{10, 10, 10};
-        /* sun.position = player_camera.position + glm::vec3{0, 10, 0}; */
-        sun.yaw = PI / 4;
-        sun.pitch = -PI / 4;
-        /* sun.pitch = -PI / 2; */
-
-        rotation += PI * dt;
-        wand_mesh.model = glm::rotate(glm::mat4(1), rotation, {0, 1, 0});
-
-        shotgun_mesh.model =
-            glm::translate(glm::mat4(1), player_camera.position);
-        shotgun_mesh.model =
-            glm::rotate(shotgun_mesh.model, player_camera.yaw, {0, 1, 0});
-        shotgun_mesh.model =
-            glm::rotate(shotgun_mesh.model, player_camera.pitch, {1, 0, 0});
-        shotgun_mesh.model =
-            glm::translate(shotgun_mesh.model, {0.8f, -0.6f, -1.f});
-        shotgun_mesh.model =
-            glm::rotate(shotgun_mesh.model, -PI / 2, {1, 0, 0});
-        shotgun_mesh.model = glm::scale(shotgun_mesh.model, glm::vec3(0.8f));
-
-        // rendering
-        std::vector<Mesh*> normal_meshes_to_render = {&floor_mesh, &cube_mesh,
-                                                      &wand_mesh};
-        {  // sun camera rendering
-            sun.bind_fbo();
-            glClearColor(1.f, 0.7f, 0.7f, 1.f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        shadows.update(player_camera.get_view_mat(), player_camera.projection,
+                       SUN_DIRECTION);
+        lod_view.set(player_camera.position, player_camera.projection);
+
+        scene.set_rotation(wand_node,
+                           glm::angleAxis(sim.wand_rotation, Y_AXIS));
+        scene.set_position(camera_node, player_camera.position);
+        scene.set_rotation(camera_node,
+                           glm::angleAxis(player_camera.yaw, Y_AXIS) *
+                               glm::angleAxis(player_camera.pitch, X_AXIS));
+        scene.update();
+        wand_mesh.set_model(scene.world[wand_node], scene.normal[wand_node]);
+        shotgun_mesh.set_model(scene.world[shotgun_node],
+                               scene.normal[shotgun_node]);
+        profiler.end();
+
+        // recording, a job per batch of items of every pass
+        profiler.begin("record", false);
+        // the newest camera depth read back so far, headless waits for it
+        if (options.occlusion_cull) hiz.update(options.headless);
+        Mesh* normal_meshes_to_render[] = {&floor_mesh, &cube_mesh,
+                                           &wand_mesh};
+        for (auto mesh : normal_meshes_to_render) render_queue.push(mesh);
+        chunk_mesher.push(render_queue);
+        push_stress_scene(render_queue, stress_wands, naive_wands);
+        render_queue.prepare(&jobs);
+        overlay_queue.push(&shotgun_mesh);
+        overlay_queue.prepare();
+
+        JobCounter cascade_recorded[SHADOW_CASCADES], camera_recorded;
+        for (int i = 0; i < SHADOW_CASCADES; i++) {
+            PassUniforms pass = {};
+            pass.projection = shadows.projections[i];
+            pass.view = shadows.views[i];
+            pass.depth_prog = shadow_glprog;
+            pass.depth_instanced_prog = shadow_instanced_glprog;
+            pass.lod_bias = SHADOW_LOD_BIAS;
+            render_queue.record(pass, cascade_commands[i], &jobs,
+                                &cascade_recorded[i]);
+        }
+
+        PassUniforms camera_pass = {};
+        camera_pass.projection = player_camera.projection;
+        camera_pass.view = player_camera.get_view_mat();
+        camera_pass.shadows = &shadows;
+        camera_pass.occlusion = options.occlusion_cull ? &hiz : 0;
+        render_queue.record(camera_pass, camera_commands, &jobs,
+                            &camera_recorded);
+
+        PassUniforms overlay_pass = camera_pass;
+        overlay_pass.shadows = 0;
+        overlay_pass.occlusion = 0;
+        overlay_queue.record(overlay_pass, overlay_commands);
+        profiler.end();
+
+        // rendering, each pass starts once its own recording is done
+        {  // sun rendering, every cascade gets only the casters inside it
+            ProfileScope scope("sun pass");
             glEnable(GL_DEPTH_TEST);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(SHADOW_OFFSET_FACTOR, SHADOW_OFFSET_UNITS);
+            if (options.shadow_cull_front) {
+                glEnable(GL_CULL_FACE);
+                glCullFace(GL_FRONT);
+            }
+            sun_cull = {};
 
-            glm::mat4 projection = sun.projection;
-            glm::mat4 view = sun.get_view_mat();
+            for (int i = 0; i < SHADOW_CASCADES; i++) {
+                shadows.bind(i);
+                glClear(GL_DEPTH_BUFFER_BIT);
 
-            for (auto mesh : normal_meshes_to_render) {
-                mesh->tex1 = 0;
-                mesh->render(view, projection);
+                jobs.wait(cascade_recorded[i]);
+                CullStats cascade_cull = cascade_commands[i].replay();
+                sun_cull.visible += cascade_cull.visible;
+                sun_cull.culled += cascade_cull.culled;
             }
 
-            sun.unbind_fbo();
+            glDisable(GL_POLYGON_OFFSET_FILL);
+            glDisable(GL_CULL_FACE);
+            glCullFace(GL_BACK);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
         }
 
         {  // main camera rendering
+            ProfileScope scope("camera pass");
             player_camera.bind_fbo();
             glClearColor(0.7f, 0.7f, 0.7f, 1.f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             glEnable(GL_DEPTH_TEST);
 
-            glm::mat4 projection = player_camera.projection;
-            glm::mat4 view = player_camera.get_view_mat();
+            jobs.wait(camera_recorded);
+            camera_cull = camera_commands.replay();
 
-            glm::mat4 sun_projection = sun.projection;
-            glm::mat4 sun_view = sun.get_view_mat();
+            // before the overlay, the shotgun moves with the camera and
+            // would hide whatever it was in front of
+            if (options.occlusion_cull) {
+                ProfileScope scope("hiz capture");
+                hiz.capture(player_camera.depth_tex,
+                            camera_pass.projection * camera_pass.view);
+                player_camera.bind_fbo();
+            }
 
-            for (auto mesh : normal_meshes_to_render) {
-                mesh->tex1 = sun.depth_tex;
-                mesh->render(view, projection, sun_view, sun_projection);
+            if (options.debug_draw) {  // streamed, drawn with the pass above
+                for (auto mesh : normal_meshes_to_render)
+                    push_bounds(stream_buffer, *mesh, pack_rgba(0, 200, 0));
+                for (auto& entry : chunk_mesher.meshes)
+                    push_bounds(stream_buffer, entry.second,
+                                pack_rgba(0, 0, 200));
+                glm::vec3 hit;
+                if (voxel_world.raycast(player_camera.position,
+                                        player_camera.get_forward(),
+                                        EDIT_REACH, hit))
+                    push_marker(stream_buffer, hit, 0.2f,
+                                pack_rgba(220, 40, 40));
+                stream_buffer.flush();
+                render_stats.draw_calls += stream_buffer.draw_calls;
             }
 
             // clear depth buffer to draw always on top
             /* glClear(GL_DEPTH_BUFFER_BIT); */
-            shotgun_mesh.render(view, projection);
+            CullStats shotgun_cull = overlay_commands.replay();
+            camera_cull.visible += shotgun_cull.visible;
+            camera_cull.culled += shotgun_cull.culled;
 
             player_camera.unbind_fbo();
         }
 
+        profiler.begin("screen blit", true);
         glDisable(GL_DEPTH_TEST);
         // render main camera framebuffer
         screen_quad_mesh.render(glm::mat4(1), glm::mat4(1));
+        profiler.end();
+
+        frame_uniforms.end_frame();
+        stream_buffer.end_frame();
 
         // glfw things after render
+        profiler.begin("swap", false);
         glfwSwapBuffers(window);
+        profiler.end();
         glfwPollEvents();
+        if (!frame_count)
+            std::cout << "[INFO] First frame after "
+                      << std::chrono::duration<float, std::milli>(
+                             std::chrono::high_resolution_clock::now() -
+                             startup_time)
+                             .count()
+                      << " ms" << std::endl;
+        if (frame_count >= ALLOC_WARMUP_FRAMES)
+            steady_allocations += heap_allocations - frame_start_allocations;
+        frame_count++;
+    }
+
+    if (options.headless) {
+        glFinish();
+        float seconds = std::chrono::duration<float>(
+                            std::chrono::high_resolution_clock::now() -
+                            start_time)
+                            .count();
+        std::cout << "[INFO] Headless: " << frame_count << " frames in "
+                  << seconds << " s (" << frame_count / seconds << " fps)"
+                  << std::endl;
+        profiler.print_summary(std::cout);
+    }
+    if (options.screenshot_path)
+        save_screenshot(player_camera, options.screenshot_path);
+    simulation.stop();
+    if (options.record_path) recorded_path.save(options.record_path);
+    bool allocs_ok = true;
+    if (options.check_allocs) {
+        int steady_frames = std::max(0, frame_count - ALLOC_WARMUP_FRAMES);
+        std::cout << "[INFO] Steady state: " << steady_allocations
+                  << " heap allocations in " << steady_frames << " frames"
+                  << std::endl;
+        allocs_ok = steady_allocations == 0;
+        if (!allocs_ok)
+            std::cerr << "[ERROR] Steady frames allocated from the heap"
+                      << std::endl;
     }
 
     // Exiting
+    if (options.trace_path) profiler.write_chrome_trace(options.trace_path);
+    chunk_mesher.destroy();
+    assets.destroy();
+    texture_manager.destroy();
+    profiler.destroy();
+    hiz.destroy();
+    shadows.destroy();
+    frame_uniforms.destroy();
+    stream_buffer.destroy();
+    shader_manager.destroy();
     glfwDestroyWindow(window);
     glfwTerminate();
     std::cout << "[INFO] Exiting gracefully" << std::endl;
-    exit(EXIT_SUCCESS);
+    exit(allocs_ok ? EXIT_SUCCESS : EXIT_FAILURE);
 
     return 0;
 }
@@ -5,73 +5,358 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/matrix.hpp>
 #include <iostream>
+#include <utility>
 
+#include "arena.hpp"
+#include "frame_data.hpp"
+#include "mesh_cache.hpp"
+#include "obj.hpp"
+#include "render_queue.hpp"
+#include "shader_manager.hpp"
+#include "texture_manager.hpp"
 #include "util.hpp"
+#include "vox.hpp"
 
-Mesh::Mesh(std::vector<Vertex>& verticies, GLuint shader_prog, GLuint texture0,
-           GLuint texture1)
+Mesh::Mesh(MeshData&& mesh, GLuint shader_prog, GLuint texture0,
+           GLuint texture1, bool keep_cpu_copy)
     : prog(shader_prog),
-      verticies(verticies),
       model(glm::mat4(1)),
+      normal_model(glm::mat3(1)),
+      normal_source(glm::mat4(1)),
+      ebo(0),
+      packed(false),
+      position_step(1),
+      keep_cpu_copy(keep_cpu_copy),
+      vertex_count(mesh.verticies.size()),
+      index_count(mesh.indicies.size()),
+      palette_layer(0),
       tex0(texture0),
       tex1(texture1) {
+    init_indexed(mesh.verticies.data(), mesh.indicies);
+    if (keep_cpu_copy) {
+        verticies = std::move(mesh.verticies);
+        indicies = std::move(mesh.indicies);
+    }
+}
+
+Mesh::Mesh(MeshData&& mesh, float position_step, GLuint shader_prog,
+           GLuint texture0, GLuint texture1, bool keep_cpu_copy)
+    : prog(shader_prog),
+      model(glm::mat4(1)),
+      normal_model(glm::mat3(1)),
+      normal_source(glm::mat4(1)),
+      ebo(0),
+      packed(true),
+      position_step(position_step),
+      keep_cpu_copy(keep_cpu_copy),
+      vertex_count(mesh.verticies.size()),
+      index_count(mesh.indicies.size()),
+      palette_layer(0),
+      tex0(texture0),
+      tex1(texture1) {
+    ArenaScope scratch(load_arena);
+    LoadVector<PackedVertex> packed_verticies(vertex_count);
+    if (!pack_voxel_verticies(mesh.verticies.data(), vertex_count,
+                              position_step, packed_verticies.data()))
+        std::cerr << "[WARN] Mesh verticies don't fit the voxel layout, "
+                     "they were rounded"
+                  << std::endl;
+    init_indexed(packed_verticies.data(), mesh.indicies);
+    if (keep_cpu_copy) {
+        verticies = std::move(mesh.verticies);
+        indicies = std::move(mesh.indicies);
+    }
+}
+
+Mesh::Mesh(const Vertex* verticies, size_t vertex_count, const void* indicies,
+           size_t index_count, GLenum index_type, GLuint shader_prog,
+           GLuint texture0, GLuint texture1)
+    : prog(shader_prog),
+      model(glm::mat4(1)),
+      normal_model(glm::mat3(1)),
+      normal_source(glm::mat4(1)),
+      ebo(0),
+      packed(false),
+      position_step(1),
+      keep_cpu_copy(false),
+      index_type(index_type),
+      vertex_count(vertex_count),
+      index_count(index_count),
+      palette_layer(0),
+      tex0(texture0),
+      tex1(texture1) {
+    init(verticies, indicies);
+}
+
+Mesh::Mesh(Mesh&& other) noexcept
+    : vao(0), vbo(0), ebo(0), shadow_vao(0), position_vbo(0) {
+    *this = std::move(other);
+}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+
+    verticies = std::move(other.verticies);
+    indicies = std::move(other.indicies);
+    model = other.model;
+    prog = other.prog;
+    tex0 = other.tex0;
+    tex1 = other.tex1;
+    palette_layer = other.palette_layer;
+    packed = other.packed;
+    position_step = other.position_step;
+    keep_cpu_copy = other.keep_cpu_copy;
+    modelID = other.modelID;
+    normal_modelID = other.normal_modelID;
+    tex0_ID = other.tex0_ID;
+    tex1_ID = other.tex1_ID;
+    position_stepID = other.position_stepID;
+    palette_layerID = other.palette_layerID;
+    uniforms_version = other.uniforms_version;
+    index_type = other.index_type;
+    vertex_count = other.vertex_count;
+    index_count = other.index_count;
+    bounds = other.bounds;
+    bounds_model = other.bounds_model;
+    world_center = other.world_center;
+    world_radius = other.world_radius;
+    normal_model = other.normal_model;
+    normal_source = other.normal_source;
+    lods = std::move(other.lods);
+    lod = other.lod;
+    lod_frame = other.lod_frame;
+
+    // GL objects change owner, the moved from mesh deletes nothing
+    vao = std::exchange(other.vao, 0);
+    vbo = std::exchange(other.vbo, 0);
+    ebo = std::exchange(other.ebo, 0);
+    shadow_vao = std::exchange(other.shadow_vao, 0);
+    position_vbo = std::exchange(other.position_vbo, 0);
+    return *this;
+}
+
+void Mesh::init_indexed(const void* verticies,
+                        std::vector<uint32_t> const& indicies) {
+    if (vertex_count <= 0x10000) {  // 16-bit indicies are enough
+        ArenaScope scratch(load_arena);
+        LoadVector<uint16_t> short_indicies(indicies.begin(), indicies.end());
+        index_type = GL_UNSIGNED_SHORT;
+        init(verticies, short_indicies.data());
+    } else {
+        index_type = GL_UNSIGNED_INT;
+        init(verticies, indicies.data());
+    }
+}
+
+void Mesh::init(const void* verticies, const void* indicies) {
+    glGenBuffers(1, &vbo);
+    position_vbo = 0;
+    if (!packed) glGenBuffers(1, &position_vbo);
+    if (index_count) glGenBuffers(1, &ebo);
+
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
+    setup_vertex_attribs(false);
 
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, verticies.size() * sizeof(Vertex),
-                 verticies.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GLFW_FALSE, sizeof(Vertex),
-                          (void*)offsetof(Vertex, position));
-    glVertexAttribPointer(1, 2, GL_FLOAT, GLFW_FALSE, sizeof(Vertex),
-                          (void*)offsetof(Vertex, texture_coord));
-    glVertexAttribPointer(2, 3, GL_FLOAT, GLFW_FALSE, sizeof(Vertex),
-                          (void*)offsetof(Vertex, normal));
+    glGenVertexArrays(1, &shadow_vao);
+    glBindVertexArray(shadow_vao);
+    setup_vertex_attribs(true);
     glBindVertexArray(0);
 
-    modelID = glGetUniformLocation(prog, "model");
-    assert(modelID >= 0);
-    viewID = glGetUniformLocation(prog, "view");
-    assert(viewID >= 0);
-    projectionID = glGetUniformLocation(prog, "projection");
-    assert(projectionID >= 0);
-    normal_modelID = glGetUniformLocation(prog, "normal_model");
-    assert(normal_modelID >= 0);
+    upload(verticies, indicies);
 
-    sun_viewID = glGetUniformLocation(prog, "sun_view");
-    assert(sun_viewID >= 0);
-    sun_projectionID = glGetUniformLocation(prog, "sun_projection");
-    assert(sun_projectionID >= 0);
+    lookup_uniforms();
+    if (modelID < 0)
+        std::cerr << "[WARN] Mesh program " << prog << " has no model uniform"
+                  << std::endl;
 
-    tex0_ID = glGetUniformLocation(prog, "tex0");
+    // samplers always read from the same texture units
+    glUseProgram(prog);
     glUniform1i(tex0_ID, 0);
-    tex1_ID = glGetUniformLocation(prog, "tex1");
     glUniform1i(tex1_ID, 1);
+    glUseProgram(0);
+}
+
+void Mesh::setup_vertex_attribs(bool position_only) const {
+    if (packed) {
+        // the 8 byte verticies are small enough to feed depth passes too
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(PackedVertex),
+                              (void*)offsetof(PackedVertex, position));
+        glEnableVertexAttribArray(0);
+        if (!position_only) {
+            glVertexAttribIPointer(1, 2, GL_UNSIGNED_BYTE,
+                                   sizeof(PackedVertex),
+                                   (void*)offsetof(PackedVertex, normal));
+            glEnableVertexAttribArray(1);
+        }
+    } else if (position_only) {
+        // 12 bytes per vertex instead of 32 for the shadow pass
+        glBindBuffer(GL_ARRAY_BUFFER, position_vbo);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
+        glEnableVertexAttribArray(0);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GLFW_FALSE, sizeof(Vertex),
+                              (void*)offsetof(Vertex, position));
+        glVertexAttribPointer(1, 2, GL_FLOAT, GLFW_FALSE, sizeof(Vertex),
+                              (void*)offsetof(Vertex, texture_coord));
+        glVertexAttribPointer(2, 3, GL_FLOAT, GLFW_FALSE, sizeof(Vertex),
+                              (void*)offsetof(Vertex, normal));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+    }
+    if (ebo) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+}
+
+size_t Mesh::vertex_bytes() const {
+    return vertex_count * (packed ? sizeof(PackedVertex)
+                                  : sizeof(Vertex) + sizeof(glm::vec3));
+}
+
+void Mesh::upload(const void* verticies, const void* indicies) {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    size_t vertex_size = packed ? sizeof(PackedVertex) : sizeof(Vertex);
+    glBufferData(GL_ARRAY_BUFFER, vertex_count * vertex_size, verticies,
+                 GL_STATIC_DRAW);
+
+    // positions as the shaders see them, for bounds and the shadow stream
+    ArenaScope scratch(load_arena);
+    LoadVector<glm::vec3> positions(vertex_count);
+    if (packed) {
+        const PackedVertex* packed_verticies = (const PackedVertex*)verticies;
+        for (GLsizei i = 0; i < vertex_count; i++) {
+            const int16_t* p = packed_verticies[i].position;
+            positions[i] = glm::vec3(p[0], p[1], p[2]) * position_step;
+        }
+    } else {
+        for (GLsizei i = 0; i < vertex_count; i++)
+            positions[i] = ((const Vertex*)verticies)[i].position;
+        glBindBuffer(GL_ARRAY_BUFFER, position_vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertex_count * sizeof(glm::vec3),
+                     positions.data(), GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (index_count) {
+        size_t index_size = index_type == GL_UNSIGNED_SHORT
+                                ? sizeof(uint16_t)
+                                : sizeof(uint32_t);
+        // the element buffer binding is VAO state, so go through ours
+        glBindVertexArray(vao);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * index_size,
+                     indicies, GL_STATIC_DRAW);
+        glBindVertexArray(0);
+    }
+
+    bounds = compute_bounds(positions.data(), vertex_count);
+    bounds_model = glm::mat4(0);  // forces the next update
+    world_center = bounds.center;
+    world_radius = bounds.radius;
+
+    lods.assign(1, {0, (uint32_t)index_count});
+    lod = 0;
+    lod_frame = 0;
+}
+
+void Mesh::set_lods(std::vector<MeshLod> const& ranges) {
+    if (ranges.empty()) return;
+    lods = ranges;
+    index_count = lods[0].index_count;
+    lod = 0;
+}
+
+void Mesh::replace_geometry(const void* verticies, size_t vertex_count,
+                            const void* indicies, size_t index_count,
+                            GLenum index_type) {
+    if (index_count && !ebo) {
+        glGenBuffers(1, &ebo);
+        glBindVertexArray(shadow_vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBindVertexArray(0);
+    }
+
+    this->vertex_count = vertex_count;
+    this->index_count = index_count;
+    this->index_type = index_type;
+    this->verticies.clear();
+    this->indicies.clear();
+    upload(verticies, indicies);
+}
+
+void Mesh::replace_geometry(MeshData const& mesh) {
+    ArenaScope scratch(load_arena);
+    LoadVector<PackedVertex> packed_verticies;
+    const void* vertex_data = mesh.verticies.data();
+    if (packed) {
+        packed_verticies.resize(mesh.verticies.size());
+        if (!pack_voxel_verticies(mesh.verticies.data(), mesh.verticies.size(),
+                                  position_step, packed_verticies.data()))
+            std::cerr << "[WARN] Mesh verticies don't fit the voxel layout, "
+                         "they were rounded"
+                      << std::endl;
+        vertex_data = packed_verticies.data();
+    }
+
+    if (mesh.verticies.size() <= 0x10000) {  // 16-bit indicies are enough
+        LoadVector<uint16_t> short_indicies(mesh.indicies.begin(),
+                                            mesh.indicies.end());
+        replace_geometry(vertex_data, mesh.verticies.size(),
+                         short_indicies.data(), short_indicies.size(),
+                         GL_UNSIGNED_SHORT);
+    } else {
+        replace_geometry(vertex_data, mesh.verticies.size(),
+                         mesh.indicies.data(), mesh.indicies.size(),
+                         GL_UNSIGNED_INT);
+    }
+    if (keep_cpu_copy) {
+        verticies = mesh.verticies;
+        indicies = mesh.indicies;
+    }
+}
+
+void Mesh::lookup_uniforms() {
+    modelID = glGetUniformLocation(prog, "model");
+    normal_modelID = glGetUniformLocation(prog, "normal_model");
+    tex0_ID = glGetUniformLocation(prog, "tex0");
+    tex1_ID = glGetUniformLocation(prog, "tex1");
+    position_stepID = glGetUniformLocation(prog, "position_step");
+    palette_layerID = glGetUniformLocation(prog, "palette_layer");
+    uniforms_version = shader_manager.version;
+}
+
+void Mesh::refresh_uniforms() {
+    if (uniforms_version != shader_manager.version) lookup_uniforms();
 }
 
 Mesh Mesh::create_quad(glm::vec3 top_left, glm::vec3 top_right,
                        glm::vec3 bottom_right, glm::vec3 bottom_left,
                        GLuint shader_prog, GLuint texture0, GLuint texture1) {
-    std::vector<Vertex> verticies = {
+    MeshData quad;
+    quad.verticies = {
         {.position = top_left, .texture_coord = {0.0f, 1.0f}},
         {.position = bottom_left, .texture_coord = {0.0f, 0.0f}},
         {.position = top_right, .texture_coord = {1.0f, 1.0f}},
-        {.position = top_right, .texture_coord = {1.0f, 1.0f}},
-        {.position = bottom_left, .texture_coord = {0.0f, 0.0f}},
         {.position = bottom_right, .texture_coord = {1.0f, 0.0f}},
     };
+    quad.indicies = {0, 1, 2, 2, 1, 3};
 
-    return Mesh(verticies, shader_prog, texture0, texture1);
+    return Mesh(std::move(quad), shader_prog, texture0, texture1);
 }
 
 Mesh Mesh::create_cube(glm::vec3 center, float a, GLuint shader_prog) {
     float ha = a * 0.5f;
-    std::vector<Vertex> cube_verticies;
+    MeshData cube;
+    cube.verticies.reserve(24);
+    cube.indicies.reserve(36);
 
     // bottom
     {
-        std::vector<Vertex> tmp = {
+        Vertex quad[4] = {
             {.position = center + glm::vec3{-1, -1, -1} * ha,
              .texture_coord = {1.0f, 0.0f},
              .normal = {0, -1, 0}},
@@ -85,13 +370,12 @@ Mesh Mesh::create_cube(glm::vec3 center, float a, GLuint shader_prog) {
              .texture_coord = {1.0f, 1.0f},
              .normal = {0, -1, 0}},
         };
-        tmp = quad_of_four_verticies(tmp);
-        cube_verticies.insert(cube_verticies.end(), tmp.begin(), tmp.end());
+        append_quad(cube, quad);
     }
 
     // top
     {
-        std::vector<Vertex> tmp = {
+        Vertex quad[4] = {
             {.position = center + glm::vec3{-1, 1, 1} * ha,
              .texture_coord = {0.0f, 1.0f},
              .normal = {0, 1, 0}},
@@ -105,13 +389,12 @@ Mesh Mesh::create_cube(glm::vec3 center, float a, GLuint shader_prog) {
              .texture_coord = {0.0f, 0.0f},
              .normal = {0, 1, 0}},
         };
-        tmp = quad_of_four_verticies(tmp);
-        cube_verticies.insert(cube_verticies.end(), tmp.begin(), tmp.end());
+        append_quad(cube, quad);
     }
 
     // front
     {
-        std::vector<Vertex> tmp = {
+        Vertex quad[4] = {
             {.position = center + glm::vec3{-1, 1, -1} * ha,
              .texture_coord = {0.0f, 1.0f},
              .normal = {0, 0, -1}},
@@ -125,13 +408,12 @@ Mesh Mesh::create_cube(glm::vec3 center, float a, GLuint shader_prog) {
              .texture_coord = {0.0f, 0.0f},
              .normal = {0, 0, -1}},
         };
-        tmp = quad_of_four_verticies(tmp);
-        cube_verticies.insert(cube_verticies.end(), tmp.begin(), tmp.end());
+        append_quad(cube, quad);
     }
 
     // back
     {
-        std::vector<Vertex> tmp = {
+        Vertex quad[4] = {
             {.position = center + glm::vec3{-1, -1, 1} * ha,
              .texture_coord = {1.0f, 0.0f},
              .normal = {0, 0, 1}},
@@ -145,13 +427,12 @@ Mesh Mesh::create_cube(glm::vec3 center, float a, GLuint shader_prog) {
              .texture_coord = {1.0f, 1.0f},
              .normal = {0, 0, 1}},
         };
-        tmp = quad_of_four_verticies(tmp);
-        cube_verticies.insert(cube_verticies.end(), tmp.begin(), tmp.end());
+        append_quad(cube, quad);
     }
 
     // right
     {
-        std::vector<Vertex> tmp = {
+        Vertex quad[4] = {
             {.position = center + glm::vec3{1, 1, -1} * ha,
              .texture_coord = {0.0f, 1.0f},
              .normal = {1, 0, 0}},
@@ -165,13 +446,12 @@ Mesh Mesh::create_cube(glm::vec3 center, float a, GLuint shader_prog) {
              .texture_coord = {0.0f, 0.0f},
              .normal = {1, 0, 0}},
         };
-        tmp = quad_of_four_verticies(tmp);
-        cube_verticies.insert(cube_verticies.end(), tmp.begin(), tmp.end());
+        append_quad(cube, quad);
     }
 
     // left
     {
-        std::vector<Vertex> tmp = {
+        Vertex quad[4] = {
             {.position = center + glm::vec3{-1, -1, -1} * ha,
              .texture_coord = {1.0f, 0.0f},
              .normal = {-1, 0, 0}},
@@ -185,54 +465,155 @@ Mesh Mesh::create_cube(glm::vec3 center, float a, GLuint shader_prog) {
              .texture_coord = {1.0f, 1.0f},
              .normal = {-1, 0, 0}},
         };
-        tmp = quad_of_four_verticies(tmp);
-        cube_verticies.insert(cube_verticies.end(), tmp.begin(), tmp.end());
+        append_quad(cube, quad);
     }
 
-    return Mesh(cube_verticies, shader_prog);
+    return Mesh(std::move(cube), shader_prog);
+}
+
+Mesh Mesh::create_placeholder(GLuint shader_prog, GLuint texture0,
+                              bool packed) {
+    if (packed) {  // two voxels wide, colored with the first palette entry
+        VoxModel model = {};
+        model.size = {2, 2, 2};
+        model.voxels.assign(8, 1);
+        return Mesh(greedy_mesh_voxels(model), VOX_SCALE, shader_prog,
+                    texture0);
+    }
+
+    Mesh placeholder = create_cube({0, 0.1f, 0}, 0.2f, shader_prog);
+    placeholder.tex0 = texture0;
+    return placeholder;
 }
 
 Mesh Mesh::create_from_obj(const char* filename, GLuint shader_prog,
                            GLuint texture0, GLuint texture1) {
-    std::vector<Vertex> verticies = parse_obj_format(load_whole_file(filename));
-    return Mesh(verticies, shader_prog, texture0, texture1);
+    MappedMeshCache cache;
+    if (open_mesh_cache_for(filename, cache)) {
+        std::cout << "[INFO] Loaded mesh \"" << filename << "\" from cache"
+                  << std::endl;
+        GLenum index_type = cache.header->index_size == sizeof(uint16_t)
+                                ? GL_UNSIGNED_SHORT
+                                : GL_UNSIGNED_INT;
+        Mesh result(cache.verticies, cache.header->vertex_count,
+                    cache.indicies, cache.header->index_count, index_type,
+                    shader_prog, texture0, texture1);
+        result.set_lods(std::vector<MeshLod>(
+            cache.header->lods, cache.header->lods + cache.header->lod_count));
+        return result;
+    }
+
+    std::string source = load_whole_file(filename);
+    ObjData data = parse_obj_data(source);
+    MeshData full = assemble_obj_indexed(data);
+
+    std::cout << "[INFO] Loaded mesh \"" << filename << "\": "
+              << data.corners.size() << " -> " << full.verticies.size()
+              << " verticies ("
+              << (float)data.corners.size() / full.verticies.size()
+              << "x less)" << std::endl;
+
+    std::vector<MeshLod> lods;
+    MeshData mesh = merge_lods(build_mesh_lods(std::move(full)), lods);
+
+    SourceStamp stamp;
+    if (get_source_stamp(filename, stamp))
+        write_mesh_cache(mesh_cache_path(filename).c_str(), mesh, stamp,
+                         hash_bytes(source), lods);
+
+    Mesh result(std::move(mesh), shader_prog, texture0, texture1);
+    result.set_lods(lods);
+    return result;
+}
+
+Mesh Mesh::create_from_vox(const char* filename, GLuint shader_prog,
+                           GLuint texture0, GLuint texture1) {
+    VoxModel model;
+    MeshData mesh;
+    std::vector<MeshLod> lods;
+    if (parse_vox_format(load_whole_file(filename), model)) {
+        mesh = merge_lods(build_vox_lods(model), lods);
+    } else {
+        std::cerr << "[ERROR] Failed to load VOX model: " << filename
+                  << std::endl;
+    }
+
+    int palette_layer = 0;
+    if (!texture0 && model.has_palette) {
+        texture0 = texture_manager.palette_array;
+        palette_layer = texture_manager.palette_for(model.palette);
+    }
+
+    Mesh result(std::move(mesh), VOX_SCALE, shader_prog, texture0, texture1);
+    result.set_lods(lods);
+    result.palette_layer = palette_layer;
+    size_t triangles = result.index_count / 3;
+
+    std::cout << "[INFO] Loaded mesh \"" << filename << "\": "
+              << triangles << " triangles, "
+              << result.vertex_bytes() / 1024.f << " KiB of verticies"
+              << std::endl;
+    return result;
 }
 
-void Mesh::render(glm::mat4 view, glm::mat4 projection, glm::mat4 sun_view, glm::mat4 sun_projection) {
+void Mesh::render(glm::mat4 view, glm::mat4 projection) {
+    FrameData frame = {};
+    frame.view = view;
+    frame.projection = projection;
+    frame_uniforms.write(frame);
+    render_stats.uniform_uploads++;
+
     // Use shader program
     glUseProgram(prog);
+    render_stats.program_binds++;
+    refresh_uniforms();
     // rendering
     glUniformMatrix4fv(modelID, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewID, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projectionID, 1, GL_FALSE, glm::value_ptr(projection));
-    glUniformMatrix4fv(sun_viewID, 1, GL_FALSE, glm::value_ptr(sun_view));
-    glUniformMatrix4fv(sun_projectionID, 1, GL_FALSE, glm::value_ptr(sun_projection));
-
-    glm::mat3 normal_model = glm::transpose(glm::inverse(model));
+    update_normal_model();
     glUniformMatrix3fv(normal_modelID, 1, GL_FALSE,
                        glm::value_ptr(normal_model));
+    render_stats.uniform_uploads += 2;
+    if (position_stepID >= 0) {
+        glUniform1f(position_stepID, position_step);
+        render_stats.uniform_uploads++;
+    }
+    if (palette_layerID >= 0) {
+        glUniform1f(palette_layerID, palette_layer);
+        render_stats.uniform_uploads++;
+    }
     if (tex0_ID && tex0) {
-        glUniform1i(tex0_ID, 0);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, tex0);
+        glBindTexture(packed ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, tex0);
+        render_stats.texture_binds++;
     }
     if (tex1_ID && tex1) {
-        glUniform1i(tex1_ID, 1);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, tex1);
+        render_stats.texture_binds++;
     }
 
     glBindVertexArray(vao);
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
+    render_stats.vao_binds++;
 
-    glDrawArrays(GL_TRIANGLES, 0, verticies.size());
+    draw();
 
     glBindVertexArray(0);
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(2);
+}
+
+void Mesh::draw(int lod) {
+    if (ebo) {
+        MeshLod const& range = lods[std::min<size_t>(lod, lods.size() - 1)];
+        size_t index_size = index_type == GL_UNSIGNED_SHORT
+                                ? sizeof(uint16_t)
+                                : sizeof(uint32_t);
+        glDrawElements(GL_TRIANGLES, range.index_count, index_type,
+                       (void*)(range.first_index * index_size));
+        render_stats.triangles += range.index_count / 3;
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, vertex_count);
+        render_stats.triangles += vertex_count / 3;
+    }
+    render_stats.draw_calls++;
 }
 
 void Mesh::set_uniform(const char* name, glm::mat4 m) {
@@ -240,7 +621,45 @@ void Mesh::set_uniform(const char* name, glm::mat4 m) {
     glUniformMatrix4fv(id, 1, GL_FALSE, glm::value_ptr(m));
 }
 
-Mesh::~Mesh() {
+void Mesh::update_world_bounds() {
+    if (model == bounds_model) return;
+    bounds_model = model;
+
+    world_center = glm::vec3(model * glm::vec4(bounds.center, 1));
+    // largest axis scale keeps the sphere conservative under non uniform scale
+    float scale = glm::max(glm::length(glm::vec3(model[0])),
+                           glm::max(glm::length(glm::vec3(model[1])),
+                                    glm::length(glm::vec3(model[2]))));
+    world_radius = bounds.radius * scale;
+}
+
+void Mesh::set_model(glm::mat4 const& model, glm::mat3 const& normal_model) {
+    this->model = normal_source = model;
+    this->normal_model = normal_model;
+}
+
+void Mesh::update_normal_model() {
+    if (model == normal_source) return;
+    normal_source = model;
+    normal_model = glm::transpose(glm::inverse(glm::mat3(model)));
+}
+
+void Mesh::update_lod() {
+    if (lods.size() < 2 || lod_frame == lod_view.frame) return;
+    lod_frame = lod_view.frame;
+    // projected radius, as a fraction of half the screen height
+    float distance =
+        std::max(glm::length(world_center - lod_view.eye), world_radius);
+    float screen_size = world_radius * lod_view.projection_scale / distance;
+    lod = select_lod(lod, lods.size(), screen_size);
+}
+
+Mesh::~Mesh() { release(); }
+
+void Mesh::release() {
     glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+    glDeleteBuffers(1, &position_vbo);
+    glDeleteVertexArrays(1, &shadow_vao);
     glDeleteVertexArrays(1, &vao);
 }
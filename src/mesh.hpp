@@ -6,29 +6,117 @@
 #include <glm/glm.hpp>
 #include <vector>
 
+#include "culling.hpp"
+#include "lod.hpp"
 #include "vertex.hpp"
 
+/*
+ * Owns its GL objects, so it can be moved but not copied. The CPU copy of
+ * the geometry is dropped after upload unless keep_cpu_copy is set.
+ */
 struct Mesh {
-    std::vector<Vertex> verticies;
+    std::vector<Vertex> verticies;  // empty unless keep_cpu_copy
+    std::vector<uint32_t> indicies;
     glm::mat4 model;
-    GLuint prog, vao, vbo, tex0, tex1;
-    GLuint modelID, viewID, projectionID, sun_viewID, sun_projectionID,
-        normal_modelID, tex0_ID, tex1_ID;
+    GLuint prog, vao, vbo, ebo, tex0, tex1;
+    // tightly packed positions sharing ebo, for depth only passes
+    GLuint shadow_vao, position_vbo;
+    // PackedVertex layout instead of Vertex, needs a program reading the
+    // attribs like shaders/voxel.vs, fixed for the life of the mesh. Colors
+    // come from layer palette_layer of tex0, a palette array
+    bool packed;
+    float position_step;  // scale of packed positions, 1 for Vertex
+    bool keep_cpu_copy;   // verticies and indicies stay after upload
+    GLint modelID, normal_modelID, tex0_ID, tex1_ID, position_stepID,
+        palette_layerID;
+    unsigned uniforms_version;  // shader_manager.version of the locations
+    GLenum index_type;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    // index_count covers the full detail level only, see lods
+    GLsizei vertex_count, index_count;
+    // index ranges of all levels of detail in ebo, full detail first
+    std::vector<MeshLod> lods;
+    int lod;              // level chosen for lod_view, see update_lod()
+    unsigned lod_frame;   // lod_view.frame lod was chosen in
+    int palette_layer;     // see TextureManager::palette_array
+    Bounds bounds;         // local space, from the uploaded verticies
+    // world bounding sphere, valid for bounds_model
+    glm::mat4 bounds_model;
+    glm::vec3 world_center;
+    float world_radius;
+    // transpose(inverse(model)) for lighting, valid for normal_source
+    glm::mat3 normal_model;
+    glm::mat4 normal_source;
 
-    Mesh(std::vector<Vertex>& verticies, GLuint shader_prog,
+    // indicies may be empty, then verticies are drawn as a triangle list
+    Mesh(MeshData&& mesh, GLuint shader_prog, GLuint texture0 = 0,
+         GLuint texture1 = 0, bool keep_cpu_copy = false);
+    // packed layout, verticies must lie on a grid of position_step, see
+    // pack_voxel_verticies()
+    Mesh(MeshData&& mesh, float position_step, GLuint shader_prog,
+         GLuint texture0 = 0, GLuint texture1 = 0, bool keep_cpu_copy = false);
+    // uploads buffers as they are (e.g. straight from mmap), keeps no copy
+    Mesh(const Vertex* verticies, size_t vertex_count, const void* indicies,
+         size_t index_count, GLenum index_type, GLuint shader_prog,
          GLuint texture0 = 0, GLuint texture1 = 0);
     static Mesh create_quad(glm::vec3 top_left, glm::vec3 top_right,
                             glm::vec3 bottom_right, glm::vec3 bottom_left,
                             GLuint shader_prog, GLuint texture0 = 0,
                             GLuint texture1 = 0);
     static Mesh create_cube(glm::vec3 center, float a, GLuint shader_prog);
+    // small cube shown until an AssetManager replaces the geometry, packed
+    // for assets that will be packed
+    static Mesh create_placeholder(GLuint shader_prog, GLuint texture0 = 0,
+                                   bool packed = false);
+    // both come with levels of detail, see build_mesh_lods() and
+    // build_vox_lods()
     static Mesh create_from_obj(const char* filename, GLuint shader_prog,
                                 GLuint texture0 = 0, GLuint texture1 = 0);
-    void render(glm::mat4 view, glm::mat4 projection,
-                glm::mat4 sun_view = glm::mat4(0),
-                glm::mat4 sun_projection = glm::mat4(0));
+    // packed layout, without texture0 the palette stored in the file gets a
+    // layer of texture_manager.palette_array
+    static Mesh create_from_vox(const char* filename, GLuint shader_prog,
+                                GLuint texture0 = 0, GLuint texture1 = 0);
+    // uploads its own FrameData, for one-off unshadowed draws outside a
+    // RenderQueue
+    void render(glm::mat4 view, glm::mat4 projection);
+    // issues the draw call, program, uniforms and VAO must be already bound
+    void draw(int lod = 0);
     void set_uniform(const char* name, glm::mat4 m);
+    // recomputes the world sphere only if model changed since last call
+    void update_world_bounds();
+    // model with a normal matrix computed elsewhere, e.g. by SceneGraph
+    void set_model(glm::mat4 const& model, glm::mat3 const& normal_model);
+    // recomputes normal_model only if model changed since it was set
+    void update_normal_model();
+    // picks lod from the world sphere once per lod_view frame
+    void update_lod();
+    // after uploading merged levels, see merge_lods()
+    void set_lods(std::vector<MeshLod> const& ranges);
+    // looks up uniform locations again after prog was reloaded
+    void refresh_uniforms();
+    // re-uploads into the same buffers, so VAOs sharing them stay valid,
+    // verticies are Vertex or PackedVertex as the mesh was created with
+    void replace_geometry(const void* verticies, size_t vertex_count,
+                          const void* indicies, size_t index_count,
+                          GLenum index_type);
+    void replace_geometry(MeshData const& mesh);
+    // points attribs 0-2 of the bound VAO at the vertex buffer, or only the
+    // position at 0 for depth passes, and binds ebo
+    void setup_vertex_attribs(bool position_only) const;
+    // GPU memory of the vertex buffers
+    size_t vertex_bytes() const;
+    Mesh(Mesh&& other) noexcept;
+    Mesh& operator=(Mesh&& other) noexcept;
+    Mesh(Mesh const&) = delete;
+    Mesh& operator=(Mesh const&) = delete;
     ~Mesh();
+
+   private:
+    void release();
+    void init_indexed(const void* verticies,
+                      std::vector<uint32_t> const& indicies);
+    void init(const void* verticies, const void* indicies);
+    void upload(const void* verticies, const void* indicies);
+    void lookup_uniforms();
 };
 
 #endif  // __MESH_HPP
@@ -0,0 +1,189 @@
+#include "mesh_cache.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "util.hpp"
+
+MappedMeshCache::MappedMeshCache()
+    : base(0), size(0), header(0), verticies(0), indicies(0) {}
+
+MappedMeshCache::~MappedMeshCache() { close(); }
+
+void MappedMeshCache::close() {
+    if (base) munmap(base, size);
+    base = 0;
+    size = 0;
+    header = 0;
+    verticies = 0;
+    indicies = 0;
+}
+
+bool MappedMeshCache::open(const char* filename) {
+    close();
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MeshCacheHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size = st.st_size;
+    base = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        base = 0;
+        size = 0;
+        return false;
+    }
+
+    header = (const MeshCacheHeader*)base;
+    size_t vertex_bytes = (size_t)header->vertex_count * sizeof(Vertex);
+    size_t index_bytes = (size_t)header->index_count * header->index_size;
+    if (memcmp(header->magic, MESH_CACHE_MAGIC, 4) != 0 ||
+        header->version != MESH_CACHE_VERSION ||
+        header->vertex_size != sizeof(Vertex) ||
+        sizeof(MeshCacheHeader) + vertex_bytes + index_bytes != size ||
+        header->lod_count < 1 || header->lod_count > MAX_LODS) {
+        close();
+        return false;
+    }
+    for (uint32_t i = 0; i < header->lod_count; i++) {
+        MeshLod const& lod = header->lods[i];
+        if ((uint64_t)lod.first_index + lod.index_count >
+            header->index_count) {
+            close();
+            return false;
+        }
+    }
+
+    verticies = (const Vertex*)((const char*)base + sizeof(MeshCacheHeader));
+    indicies = header->index_count
+                   ? (const char*)verticies + vertex_bytes
+                   : 0;
+    return true;
+}
+
+bool get_source_stamp(const char* filename, SourceStamp& stamp) {
+    struct stat st;
+    if (stat(filename, &st) != 0) return false;
+    stamp.mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    stamp.size = st.st_size;
+    return true;
+}
+
+bool update_cache_mtime(const char* cache_filename, size_t offset,
+                        int64_t mtime) {
+    // a single 8 byte write, readers see either stamp and both are valid
+    int fd = ::open(cache_filename, O_WRONLY);
+    if (fd < 0) return false;
+    bool ok = pwrite(fd, &mtime, sizeof(mtime), offset) == sizeof(mtime);
+    ::close(fd);
+    return ok;
+}
+
+bool write_mesh_cache(const char* filename, MeshData const& mesh,
+                      SourceStamp const& stamp, uint64_t source_hash,
+                      std::vector<MeshLod> const& lods) {
+    MeshCacheHeader header = {};
+    memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+    header.version = MESH_CACHE_VERSION;
+    header.source_mtime = stamp.mtime;
+    header.source_size = stamp.size;
+    header.source_hash = source_hash;
+    header.vertex_count = mesh.verticies.size();
+    header.index_count = mesh.indicies.size();
+    header.vertex_size = sizeof(Vertex);
+    header.lod_count = 1;
+    header.lods[0] = {0, (uint32_t)mesh.indicies.size()};
+    if (!lods.empty()) {
+        header.lod_count = std::min<size_t>(lods.size(), MAX_LODS);
+        std::copy(lods.begin(), lods.begin() + header.lod_count, header.lods);
+    }
+
+    header.bbox_min = glm::vec3(0);
+    header.bbox_max = glm::vec3(0);
+    if (!mesh.verticies.empty()) {
+        header.bbox_min = header.bbox_max = mesh.verticies[0].position;
+        for (Vertex const& v : mesh.verticies) {
+            header.bbox_min = glm::min(header.bbox_min, v.position);
+            header.bbox_max = glm::max(header.bbox_max, v.position);
+        }
+    }
+
+    // store indicies in the same width they are uploaded with
+    std::vector<uint16_t> short_indicies;
+    const void* index_data = mesh.indicies.data();
+    header.index_size = 0;
+    if (!mesh.indicies.empty()) {
+        header.index_size = sizeof(uint32_t);
+        if (mesh.verticies.size() <= 0x10000) {
+            short_indicies.assign(mesh.indicies.begin(), mesh.indicies.end());
+            index_data = short_indicies.data();
+            header.index_size = sizeof(uint16_t);
+        }
+    }
+
+    // write to temporary file first so readers never map half written cache
+    std::string tmp_filename = std::string(filename) + ".tmp";
+    FILE* f = fopen(tmp_filename.c_str(), "wb");
+    if (!f) {
+        std::cerr << "[WARN] Failed to write mesh cache: " << filename
+                  << std::endl;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok &= fwrite(mesh.verticies.data(), sizeof(Vertex),
+                 mesh.verticies.size(), f) == mesh.verticies.size();
+    ok &= fwrite(index_data, header.index_size, mesh.indicies.size(), f) ==
+          mesh.indicies.size();
+    ok &= fclose(f) == 0;
+
+    if (!ok || rename(tmp_filename.c_str(), filename) != 0) {
+        std::cerr << "[WARN] Failed to write mesh cache: " << filename
+                  << std::endl;
+        remove(tmp_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string mesh_cache_path(const char* source_filename) {
+    return std::string(source_filename) + MESH_CACHE_EXTENSION;
+}
+
+bool open_mesh_cache_for(const char* source_filename, MappedMeshCache& cache) {
+    SourceStamp stamp;
+    if (!get_source_stamp(source_filename, stamp)) return false;
+    if (!cache.open(mesh_cache_path(source_filename).c_str())) return false;
+
+    if (cache.header->source_size != stamp.size) {
+        cache.close();
+        return false;
+    }
+
+    // touched but maybe not changed, fall back to comparing content hash
+    if (cache.header->source_mtime != stamp.mtime) {
+        if (cache.header->source_hash !=
+            hash_bytes(load_whole_file(source_filename))) {
+            cache.close();
+            return false;
+        }
+        update_cache_mtime(mesh_cache_path(source_filename).c_str(),
+                           offsetof(MeshCacheHeader, source_mtime),
+                           stamp.mtime);
+    }
+
+    return true;
+}
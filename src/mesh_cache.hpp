@@ -0,0 +1,83 @@
+#ifndef __MESH_CACHE_HPP
+#define __MESH_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <string_view>
+
+#include "lod.hpp"
+#include "vertex.hpp"
+
+/*
+ * Binary mesh file, laid out so it can be mmaped and handed to glBufferData:
+ *
+ *   MeshCacheHeader
+ *   Vertex[vertex_count]
+ *   uint16_t or uint32_t[index_count]  (index_size bytes each)
+ *
+ * All levels of detail share the buffers, the header holds their ranges.
+ */
+const char MESH_CACHE_MAGIC[4] = {'M', 'S', 'H', 'C'};
+const uint32_t MESH_CACHE_VERSION = 2;
+const char MESH_CACHE_EXTENSION[] = ".meshcache";
+
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    // identifies the source file the cache was built from
+    int64_t source_mtime;
+    uint64_t source_size;
+    uint64_t source_hash;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t index_size;  // 2 or 4, 0 if there are no indicies
+    uint32_t vertex_size;
+    glm::vec3 bbox_min;
+    glm::vec3 bbox_max;
+    uint32_t lod_count;  // at least 1, the full mesh
+    MeshLod lods[MAX_LODS];
+};
+
+struct SourceStamp {
+    int64_t mtime;
+    uint64_t size;
+};
+
+// read-only mapping of a mesh cache file
+struct MappedMeshCache {
+    void* base;
+    size_t size;
+    const MeshCacheHeader* header;
+    const Vertex* verticies;
+    const void* indicies;
+
+    MappedMeshCache();
+    MappedMeshCache(MappedMeshCache const&) = delete;
+    MappedMeshCache& operator=(MappedMeshCache const&) = delete;
+    ~MappedMeshCache();
+
+    // maps the file and checks header and sizes
+    bool open(const char* filename);
+    void close();
+};
+
+bool get_source_stamp(const char* filename, SourceStamp& stamp);
+
+// rewrites the source_mtime found at offset of a cache file in place, for
+// caches whose source was touched but hashed the same, so later runs skip
+// the hash
+bool update_cache_mtime(const char* cache_filename, size_t offset,
+                        int64_t mtime);
+
+// lods are ranges of merged levels, see merge_lods(), none for a single one
+bool write_mesh_cache(const char* filename, MeshData const& mesh,
+                      SourceStamp const& stamp, uint64_t source_hash,
+                      std::vector<MeshLod> const& lods = {});
+
+// maps cache of source file if it exists and was built from the same source
+bool open_mesh_cache_for(const char* source_filename, MappedMeshCache& cache);
+std::string mesh_cache_path(const char* source_filename);
+
+#endif  // __MESH_CACHE_HPP
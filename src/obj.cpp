@@ -0,0 +1,344 @@
+#include "obj.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <unordered_map>
+
+#include "arena.hpp"
+
+namespace {
+
+struct ObjCounts {
+    size_t positions, texcoords, normals, faces, lines;
+};
+
+// below this size a single chunk is faster than waking the pool
+const size_t MIN_PARALLEL_CHUNK = 1 << 20;
+
+inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char* skip_blanks(const char* p, const char* end) {
+    while (p < end && is_blank(*p)) p++;
+    return p;
+}
+
+inline const char* find_line_end(const char* p, const char* end) {
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    return nl ? nl : end;
+}
+
+// first word of the line, empty for blank and comment lines
+inline std::string_view line_command(const char*& p, const char* line_end) {
+    p = skip_blanks(p, line_end);
+    if (p == line_end || *p == '#') return std::string_view();
+    const char* cmd = p;
+    while (p < line_end && !is_blank(*p)) p++;
+    return std::string_view(cmd, p - cmd);
+}
+
+// counts records exactly like parse_obj_chunk() consumes them, so a chunk
+// knows where its records go before anything is parsed
+ObjCounts count_obj_records(const char* p, const char* end) {
+    ObjCounts counts = {};
+    while (p < end) {
+        counts.lines++;
+        const char* line_end = find_line_end(p, end);
+        std::string_view command = line_command(p, line_end);
+        if (command == "v")
+            counts.positions++;
+        else if (command == "vt")
+            counts.texcoords++;
+        else if (command == "vn")
+            counts.normals++;
+        else if (command == "f")
+            counts.faces++;
+        p = line_end + 1;
+    }
+    return counts;
+}
+
+inline const char* parse_float(const char* p, const char* end, float& out,
+                               int ln) {
+    p = skip_blanks(p, end);
+    if (p < end && *p == '+') p++;
+    auto res = std::from_chars(p, end, out);
+    if (res.ec != std::errc()) {
+        std::cerr << "[WARN] Invalid number in OBJ file on line: " << ln
+                  << std::endl;
+        out = 0;
+        while (p < end && !is_blank(*p)) p++;
+        return p;
+    }
+    return res.ptr;
+}
+
+// resolves 1-based or negative (relative) OBJ index into 0-based one
+inline int resolve_index(int index, size_t count, int ln) {
+    if (index == 0) return -1;
+    long resolved = index > 0 ? index - 1 : (long)count + index;
+    if (resolved < 0 || resolved >= (long)count) {
+        std::cerr << "[ERROR] Vertex index out of range in face definition "
+                     "in OBJ file on line: "
+                  << ln << std::endl;
+        exit(1);
+    }
+    return (int)resolved;
+}
+
+// parses "p", "p/t", "p//n" or "p/t/n" into 0-terminated index triple
+inline const char* parse_corner(const char* p, const char* end,
+                                int indicies[3], int& n) {
+    n = 0;
+    indicies[0] = indicies[1] = indicies[2] = 0;
+    while (p < end && !is_blank(*p)) {
+        int acc = 0;
+        int sig = 1;
+        while (p < end && *p != '/' && !is_blank(*p)) {
+            if (*p == '-') {
+                sig *= -1;
+            } else if (*p >= '0' && *p <= '9') {
+                acc = acc * 10 + (*p - '0');
+            } else {
+                std::cerr << "[WARN] Unsupported character in vertex index: "
+                          << *p << std::endl;
+            }
+            p++;
+        }
+        if (n < 3) indicies[n] = acc * sig;
+        n++;
+        if (p < end && *p == '/') {
+            p++;
+            if (p == end || is_blank(*p)) n++;  // trailing slash, empty index
+        }
+    }
+    return p;
+}
+
+struct ObjCornerHash {
+    size_t operator()(ObjCorner const& c) const {
+        size_t h = (size_t)(uint32_t)c.position * 0x9E3779B97F4A7C15ull;
+        h ^= (size_t)(uint32_t)c.texcoord * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+        h ^= (size_t)(uint32_t)c.normal * 0x165667B19E3779F9ull + (h >> 32);
+        return h;
+    }
+};
+
+struct ObjCornerEq {
+    bool operator()(ObjCorner const& a, ObjCorner const& b) const {
+        return a.position == b.position && a.texcoord == b.texcoord &&
+               a.normal == b.normal;
+    }
+};
+
+inline Vertex corner_vertex(ObjData const& data, ObjCorner const& c) {
+    Vertex v;
+    v.position = c.position >= 0 ? data.positions[c.position] : glm::vec3(0);
+    v.texture_coord =
+        c.texcoord >= 0 ? data.texcoords[c.texcoord] : glm::vec2(0);
+    v.normal = c.normal >= 0 ? data.normals[c.normal] : glm::vec3(0);
+    return v;
+}
+
+/*
+ * Parses the lines in [p, end) into data, which is already sized for the
+ * whole file. base holds the records and lines of everything before the
+ * chunk, so records land in their final slots and relative indicies
+ * resolve against the file-wide counts.
+ */
+void parse_obj_chunk(const char* p, const char* end, ObjCounts const& base,
+                     ObjData& data) {
+    size_t positions = base.positions, texcoords = base.texcoords,
+           normals = base.normals, corners = base.faces * 3;
+    int ln = base.lines;
+    while (p < end) {  // parse line by line until the end of chunk
+        ln++;
+        const char* line_end = find_line_end(p, end);
+        const char* line_start = p;
+        std::string_view command = line_command(p, line_end);
+
+        if (command.empty()) {  // comment or empty line
+            p = line_end + 1;
+            continue;
+        }
+
+        if (command == "v") {
+            glm::vec3& v = data.positions[positions++];
+            p = parse_float(p, line_end, v.x, ln);
+            p = parse_float(p, line_end, v.y, ln);
+            p = parse_float(p, line_end, v.z, ln);
+        } else if (command == "vn") {
+            glm::vec3& n = data.normals[normals++];
+            p = parse_float(p, line_end, n.x, ln);
+            p = parse_float(p, line_end, n.y, ln);
+            p = parse_float(p, line_end, n.z, ln);
+        } else if (command == "vt") {
+            glm::vec2& tc = data.texcoords[texcoords++];
+            p = parse_float(p, line_end, tc.x, ln);
+            p = parse_float(p, line_end, tc.y, ln);
+        } else if (command == "f") {
+            for (int i = 0; i < 3; i++) {
+                int indicies[3], n;
+                p = skip_blanks(p, line_end);
+                p = parse_corner(p, line_end, indicies, n);
+
+                if (n == 0) {
+                    std::cerr << "[ERROR] Invalid vertex index format in face "
+                                 "definition in OBJ file on line: "
+                              << ln << std::endl;
+                    exit(1);
+                }
+
+                ObjCorner& corner = data.corners[corners++];
+                corner.position = resolve_index(indicies[0], positions, ln);
+                corner.texcoord = resolve_index(indicies[1], texcoords, ln);
+                corner.normal = resolve_index(indicies[2], normals, ln);
+            }
+        } else {
+            std::cerr << "[WARN] OBJ parser does not support: "
+                      << std::string_view(line_start, line_end - line_start)
+                      << std::endl;
+        }
+
+        p = line_end + 1;
+    }
+}
+
+void resize_obj_data(ObjData& data, ObjCounts const& counts) {
+    data.positions.resize(counts.positions);
+    data.texcoords.resize(counts.texcoords);
+    data.normals.resize(counts.normals);
+    data.corners.resize(counts.faces * 3);
+}
+
+// runs job(0) .. job(count - 1) on the pool and waits for all of them
+template <typename F>
+void run_chunks(ThreadPool& pool, size_t count, F job) {
+    std::vector<std::future<void>> done;
+    done.reserve(count);
+    for (size_t i = 0; i < count; i++)
+        done.push_back(pool.submit([&job, i] { job(i); }));
+    for (auto& chunk : done) chunk.get();
+}
+
+}  // namespace
+
+/*
+ * Supports only:
+ *  - 3d positions
+ *  - 3d normals
+ *  - 2d texture coords
+ *  - triangular faces
+ */
+ObjData parse_obj_data(std::string_view input) {
+    const char* begin = input.data();
+    const char* end = input.data() + input.size();
+
+    ObjData data;
+    resize_obj_data(data, count_obj_records(begin, end));
+    parse_obj_chunk(begin, end, ObjCounts{}, data);
+    return data;
+}
+
+/*
+ * Same output as parse_obj_data(). The input is split at line boundaries,
+ * every chunk counts its records, a prefix sum over the counts gives each
+ * chunk its first record and line, then all chunks parse at once.
+ */
+ObjData parse_obj_data_parallel(std::string_view input, ThreadPool& pool) {
+    size_t chunk_count =
+        std::min(pool.size(), input.size() / MIN_PARALLEL_CHUNK);
+    if (chunk_count <= 1) return parse_obj_data(input);
+
+    const char* begin = input.data();
+    const char* end = input.data() + input.size();
+
+    // chunk i is [starts[i], starts[i + 1]), each starts after a newline
+    std::vector<const char*> starts(chunk_count + 1);
+    starts[0] = begin;
+    starts[chunk_count] = end;
+    for (size_t i = 1; i < chunk_count; i++) {
+        const char* p = begin + input.size() * i / chunk_count;
+        const char* line_end = find_line_end(std::max(p, starts[i - 1]), end);
+        starts[i] = line_end < end ? line_end + 1 : end;
+    }
+
+    std::vector<ObjCounts> bases(chunk_count + 1);
+    run_chunks(pool, chunk_count, [&](size_t i) {
+        bases[i + 1] = count_obj_records(starts[i], starts[i + 1]);
+    });
+    for (size_t i = 1; i <= chunk_count; i++) {
+        bases[i].positions += bases[i - 1].positions;
+        bases[i].texcoords += bases[i - 1].texcoords;
+        bases[i].normals += bases[i - 1].normals;
+        bases[i].faces += bases[i - 1].faces;
+        bases[i].lines += bases[i - 1].lines;
+    }
+
+    ObjData data;
+    resize_obj_data(data, bases[chunk_count]);
+    run_chunks(pool, chunk_count, [&](size_t i) {
+        parse_obj_chunk(starts[i], starts[i + 1], bases[i], data);
+    });
+    return data;
+}
+
+std::vector<Vertex> assemble_obj_verticies(ObjData const& data) {
+    std::vector<Vertex> output(data.corners.size());
+    for (size_t i = 0; i < data.corners.size(); i++)
+        output[i] = corner_vertex(data, data.corners[i]);
+    return output;
+}
+
+std::vector<Vertex> assemble_obj_verticies_parallel(ObjData const& data,
+                                                    ThreadPool& pool) {
+    std::vector<Vertex> output(data.corners.size());
+    size_t chunk_count = std::max<size_t>(pool.size(), 1);
+    run_chunks(pool, chunk_count, [&](size_t chunk) {
+        size_t first = data.corners.size() * chunk / chunk_count;
+        size_t last = data.corners.size() * (chunk + 1) / chunk_count;
+        for (size_t i = first; i < last; i++)
+            output[i] = corner_vertex(data, data.corners[i]);
+    });
+    return output;
+}
+
+// deduplicates (position, texcoord, normal) triples into unique verticies
+MeshData assemble_obj_indexed(ObjData const& data) {
+    MeshData output;
+    output.indicies.reserve(data.corners.size());
+
+    // the map is the bulk of the temporaries, dropped at once on return
+    ArenaScope scratch(load_arena);
+    typedef std::pair<const ObjCorner, uint32_t> Entry;
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHash, ObjCornerEq,
+                       ArenaAllocator<Entry, get_load_arena>>
+        seen;
+    seen.reserve(data.corners.size());
+
+    for (ObjCorner const& c : data.corners) {
+        auto [it, inserted] =
+            seen.try_emplace(c, (uint32_t)output.verticies.size());
+        if (inserted) output.verticies.push_back(corner_vertex(data, c));
+        output.indicies.push_back(it->second);
+    }
+
+    return output;
+}
+
+std::vector<Vertex> parse_obj_format(std::string_view input) {
+    return assemble_obj_verticies(parse_obj_data(input));
+}
+
+std::vector<Vertex> parse_obj_format_parallel(std::string_view input,
+                                              ThreadPool& pool) {
+    return assemble_obj_verticies_parallel(
+        parse_obj_data_parallel(input, pool), pool);
+}
+
+MeshData parse_obj_format_indexed(std::string_view input) {
+    return assemble_obj_indexed(parse_obj_data(input));
+}
@@ -0,0 +1,36 @@
+#ifndef __OBJ_HPP
+#define __OBJ_HPP
+
+#include <glm/glm.hpp>
+#include <string_view>
+#include <vector>
+
+#include "thread_pool.hpp"
+#include "vertex.hpp"
+
+// one face corner, indicies are 0-based and already resolved, -1 if missing
+struct ObjCorner {
+    int position, texcoord, normal;
+};
+
+struct ObjData {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texcoords;
+    std::vector<glm::vec3> normals;
+    std::vector<ObjCorner> corners;  // 3 per triangle
+};
+
+ObjData parse_obj_data(std::string_view input);
+// identical output, chunks of the file are parsed on the pool, must not be
+// called from a job of the same pool
+ObjData parse_obj_data_parallel(std::string_view input, ThreadPool& pool);
+std::vector<Vertex> assemble_obj_verticies(ObjData const& data);
+std::vector<Vertex> assemble_obj_verticies_parallel(ObjData const& data,
+                                                    ThreadPool& pool);
+MeshData assemble_obj_indexed(ObjData const& data);
+std::vector<Vertex> parse_obj_format(std::string_view input);
+std::vector<Vertex> parse_obj_format_parallel(std::string_view input,
+                                              ThreadPool& pool);
+MeshData parse_obj_format_indexed(std::string_view input);
+
+#endif  // __OBJ_HPP
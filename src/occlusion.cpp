@@ -0,0 +1,215 @@
+#include "occlusion.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#include "frame_data.hpp"
+#include "shader_manager.hpp"
+
+void HiZBuffer::init(GLuint reduce_prog, int screen_width,
+                     int screen_height) {
+    prog = reduce_prog;
+    uniforms_version = shader_manager.version + 1;  // set on first capture
+    this->screen_width = screen_width;
+    this->screen_height = screen_height;
+
+    // halved down to a single texel, odd sizes round up
+    int width = (screen_width + DOWNSAMPLE - 1) / DOWNSAMPLE;
+    int height = (screen_height + DOWNSAMPLE - 1) / DOWNSAMPLE;
+    size_t size = 0;
+    levels.clear();
+    while (true) {
+        levels.push_back({width, height, size});
+        size += (size_t)width * height;
+        if (width == 1 && height == 1) break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    depth.assign(size, 1.f);
+
+    glGenVertexArrays(1, &vao);
+
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, levels[0].width,
+                 levels[0].height, 0, GL_RED, GL_FLOAT, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // color only, with no depth attachment the depth test always passes
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, tex, 0);
+    assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+           GL_FRAMEBUFFER_COMPLETE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(READBACKS, pbos);
+    for (int i = 0; i < READBACKS; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER,
+                     levels[0].width * levels[0].height * sizeof(float), 0,
+                     GL_STREAM_READ);
+        fences[i] = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    oldest = pending = 0;
+    view_projection = glm::mat4(1);
+    valid = false;
+    readbacks = skipped = 0;
+}
+
+void HiZBuffer::capture(GLuint depth_tex,
+                        glm::mat4 const& view_projection) {
+    // the GPU is READBACKS frames behind, waiting here would stall it
+    if (pending == READBACKS) {
+        skipped++;
+        return;
+    }
+    int i = (oldest + pending) % READBACKS;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, levels[0].width, levels[0].height);
+    glUseProgram(prog);
+    // relinking resets uniforms
+    if (uniforms_version != shader_manager.version) {
+        glUniform1i(glGetUniformLocation(prog, "downsample"), DOWNSAMPLE);
+        uniforms_version = shader_manager.version;
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, depth_tex);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    // lands in the pixel buffer later, nothing waits for it here
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+    glReadPixels(0, 0, levels[0].width, levels[0].height, GL_RED, GL_FLOAT,
+                 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    view_projections[i] = view_projection;
+    pending++;
+}
+
+void HiZBuffer::update(bool wait) {
+    // newest readback that arrived, older ones are dropped unread
+    int newest = -1;
+    while (pending) {
+        bool arrived;
+        if (wait) {
+            arrived = wait_for_fence(fences[oldest]);
+        } else {
+            // a zero timeout only polls
+            GLenum status = glClientWaitSync(fences[oldest],
+                                             GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (status == GL_TIMEOUT_EXPIRED) break;
+            arrived = status != GL_WAIT_FAILED;
+        }
+        // a readback that never arrived is dropped unread
+        glDeleteSync(fences[oldest]);
+        fences[oldest] = 0;
+        if (arrived) newest = oldest;
+        oldest = (oldest + 1) % READBACKS;
+        pending--;
+    }
+    if (newest < 0) return;
+
+    size_t bytes = levels[0].width * levels[0].height * sizeof(float);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[newest]);
+    const void* src =
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (src) {
+        memcpy(depth.data(), src, bytes);
+        // false if the storage was lost while mapped, the copy is garbage
+        if (!glUnmapBuffer(GL_PIXEL_PACK_BUFFER)) src = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    // level 0 may be overwritten already, nothing is culled until the
+    // next readback arrives
+    if (!src) {
+        valid = false;
+        return;
+    }
+
+    for (size_t l = 1; l < levels.size(); l++) {
+        Level const& below = levels[l - 1];
+        Level const& level = levels[l];
+        const float* from = depth.data() + below.offset;
+        float* to = depth.data() + level.offset;
+        for (int y = 0; y < level.height; y++) {
+            const float* row0 = from + 2 * y * below.width;
+            const float* row1 =
+                from + std::min(2 * y + 1, below.height - 1) * below.width;
+            for (int x = 0; x < level.width; x++) {
+                int x0 = 2 * x, x1 = std::min(2 * x + 1, below.width - 1);
+                to[y * level.width + x] =
+                    std::max(std::max(row0[x0], row0[x1]),
+                             std::max(row1[x0], row1[x1]));
+            }
+        }
+    }
+    view_projection = view_projections[newest];
+    valid = true;
+    readbacks++;
+}
+
+bool HiZBuffer::occluded(Bounds const& bounds,
+                         glm::mat4 const& model) const {
+    if (!valid) return false;
+
+    // screen rect and nearest depth of the box, in normalized device space
+    glm::mat4 to_clip = view_projection * model;
+    glm::vec3 low(std::numeric_limits<float>::infinity()), high(-low);
+    for (int c = 0; c < 8; c++) {
+        glm::vec3 corner = {c & 1 ? bounds.max.x : bounds.min.x,
+                            c & 2 ? bounds.max.y : bounds.min.y,
+                            c & 4 ? bounds.max.z : bounds.min.z};
+        glm::vec4 clip = to_clip * glm::vec4(corner, 1);
+        // reaches behind the camera, so it covers the view edge to edge
+        if (clip.w <= 0) return false;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        low = glm::min(low, ndc);
+        high = glm::max(high, ndc);
+    }
+    // nothing is known about what was off screen
+    if (low.x < -1 || low.y < -1 || high.x > 1 || high.y > 1) return false;
+    float nearest = low.z * 0.5f + 0.5f;
+
+    float scale_x = screen_width * 0.5f / DOWNSAMPLE;
+    float scale_y = screen_height * 0.5f / DOWNSAMPLE;
+    int x0 = (int)((low.x + 1) * scale_x);
+    int y0 = (int)((low.y + 1) * scale_y);
+    int x1 = std::min((int)((high.x + 1) * scale_x), levels[0].width - 1);
+    int y1 = std::min((int)((high.y + 1) * scale_y), levels[0].height - 1);
+
+    // coarser until the rect is at most 2 x 2 texels
+    size_t l = 0;
+    while (l + 1 < levels.size() && (x1 - x0 > 1 || y1 - y0 > 1)) {
+        x0 >>= 1, y0 >>= 1, x1 >>= 1, y1 >>= 1;
+        l++;
+    }
+    Level const& level = levels[l];
+    const float* texels = depth.data() + level.offset;
+    float farthest = 0;
+    for (int y = y0; y <= y1; y++)
+        for (int x = x0; x <= x1; x++)
+            farthest = std::max(farthest, texels[y * level.width + x]);
+    return nearest > farthest;
+}
+
+void HiZBuffer::destroy() {
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = 0;
+    }
+    glDeleteBuffers(READBACKS, pbos);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &tex);
+    glDeleteVertexArrays(1, &vao);
+}
@@ -0,0 +1,67 @@
+#ifndef __OCCLUSION_HPP
+#define __OCCLUSION_HPP
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "culling.hpp"
+
+/*
+ * Hierarchical depth of an earlier camera frame for occlusion culling on
+ * the CPU. capture() reduces the camera depth to the farthest depth of
+ * every DOWNSAMPLE x DOWNSAMPLE block and reads that back into a pixel
+ * buffer behind a fence. update() takes the newest readback that arrived,
+ * so the GL thread never waits for the GPU, and builds the coarser levels
+ * from it, every texel the farthest of the 4 below.
+ *
+ * occluded() projects a box with the view projection the depth was drawn
+ * with and compares its nearest point against the farthest depth over the
+ * texels it covers, on the level where that is at most 2 x 2 texels. The
+ * depth is a frame or more old, so things coming out from behind a wall
+ * can show up a frame late.
+ */
+struct HiZBuffer {
+    // screen pixels per side of a level 0 texel
+    static const int DOWNSAMPLE = 8;
+    // readbacks in flight, captures are skipped while all are
+    static const int READBACKS = 3;
+
+    struct Level {
+        int width, height;
+        size_t offset;  // of the first texel in depth
+    };
+
+    GLuint prog, vao;           // reduction, a triangle without buffers
+    unsigned uniforms_version;  // shader_manager.version prog was set up in
+    GLuint tex, fbo;            // GL_R32F level 0
+    int screen_width, screen_height;
+    GLuint pbos[READBACKS];
+    GLsync fences[READBACKS];
+    glm::mat4 view_projections[READBACKS];  // of the depth in each pbo
+    int oldest, pending;  // ring of readbacks in flight
+
+    // levels of the newest readback, level 0 first, read by occluded()
+    std::vector<Level> levels;
+    std::vector<float> depth;
+    glm::mat4 view_projection;  // the levels were drawn with
+    bool valid;                 // false until the first readback arrived
+    unsigned readbacks, skipped;
+
+    // prog runs shaders/hiz.vs and shaders/hiz.fs
+    void init(GLuint reduce_prog, int screen_width, int screen_height);
+    // GL thread after depth_tex was drawn with view_projection, leaves the
+    // framebuffer and viewport of level 0 bound
+    void capture(GLuint depth_tex, glm::mat4 const& view_projection);
+    // GL thread before recording. wait blocks until the last capture is
+    // in, which keeps headless frames the same from run to run
+    void update(bool wait);
+    // thread safe between updates, true if the local box bounds moved by
+    // model is behind the depth everywhere it covers
+    bool occluded(Bounds const& bounds, glm::mat4 const& model) const;
+    void destroy();
+};
+
+#endif  // __OCCLUSION_HPP
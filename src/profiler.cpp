@@ -0,0 +1,198 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+Profiler profiler;
+
+static ScopeSummary summarize(const float* samples, unsigned written) {
+    unsigned count = std::min<unsigned>(written, ScopeHistory::HISTORY);
+    if (!count) return {0, 0, 0, 0};
+
+    float sorted[ScopeHistory::HISTORY];
+    std::copy(samples, samples + count, sorted);
+    std::sort(sorted, sorted + count);
+
+    float sum = 0;
+    for (unsigned i = 0; i < count; i++) sum += sorted[i];
+    size_t p99 = std::min<size_t>(count - 1, count * 99 / 100);
+    return {sorted[0], sum / count, sorted[p99], count};
+}
+
+ScopeSummary ScopeHistory::cpu_summary() const {
+    return summarize(cpu_ms, cpu_written);
+}
+
+ScopeSummary ScopeHistory::gpu_summary() const {
+    return summarize(gpu_ms, gpu_written);
+}
+
+void Profiler::init(bool record_trace) {
+    this->record_trace = record_trace;
+    // a growing trace would hit the heap in the middle of frames
+    if (record_trace) trace.reserve(MAX_TRACE_EVENTS);
+    frame = 0;
+    dropped_gpu_results = 0;
+    for (int& count : gpu_scope_count) count = 0;
+
+    // some drivers (and software rasterizers) report no timer bits
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    gpu_enabled = bits > 0;
+    if (!gpu_enabled)
+        std::cerr << "[WARN] No GPU timer queries, profiling CPU only"
+                  << std::endl;
+
+    if (gpu_enabled)
+        for (auto& frame_scopes : gpu_scopes)
+            for (GpuScope& scope : frame_scopes)
+                glGenQueries(2, scope.queries);
+
+    origin = std::chrono::steady_clock::now();
+    gpu_origin = 0;
+    if (gpu_enabled) glGetInteger64v(GL_TIMESTAMP, &gpu_origin);
+}
+
+int64_t Profiler::now_us() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - origin)
+        .count();
+}
+
+void Profiler::add_trace(const char* name, int64_t start, int64_t duration,
+                         int track) {
+    if (!record_trace) return;
+    if (trace.size() == MAX_TRACE_EVENTS) {
+        std::cerr << "[WARN] Trace is full, further events are dropped"
+                  << std::endl;
+        record_trace = false;
+        return;
+    }
+    trace.push_back({name, start, duration, track});
+}
+
+void Profiler::begin_frame() {
+    if (!stack.empty())
+        std::cerr << "[WARN] Profiler scope \"" << stack.back().name
+                  << "\" still open at frame start" << std::endl;
+
+    frame = (frame + 1) % FRAMES;
+    if (!gpu_enabled) return;
+
+    // these queries were issued FRAMES frames ago
+    for (int i = 0; i < gpu_scope_count[frame]; i++) {
+        GpuScope& scope = gpu_scopes[frame][i];
+        GLint available = 0;
+        glGetQueryObjectiv(scope.queries[1], GL_QUERY_RESULT_AVAILABLE,
+                           &available);
+        if (!available) {
+            dropped_gpu_results++;
+            continue;
+        }
+
+        GLuint64 start, end;
+        glGetQueryObjectui64v(scope.queries[0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(scope.queries[1], GL_QUERY_RESULT, &end);
+        history(scope.name).add_gpu((end - start) / 1e6f);
+        add_trace(scope.name, ((int64_t)start - gpu_origin) / 1000,
+                  (end - start) / 1000, 1);
+    }
+    gpu_scope_count[frame] = 0;
+}
+
+void Profiler::begin(const char* name, bool gpu) {
+    int gpu_scope = -1;
+    if (gpu && gpu_enabled && gpu_scope_count[frame] < MAX_GPU_SCOPES) {
+        gpu_scope = gpu_scope_count[frame]++;
+        GpuScope& scope = gpu_scopes[frame][gpu_scope];
+        scope.name = name;
+        glQueryCounter(scope.queries[0], GL_TIMESTAMP);
+    }
+    stack.push_back({name, now_us(), gpu_scope});
+}
+
+void Profiler::end() {
+    OpenScope scope = stack.back();
+    stack.pop_back();
+
+    if (scope.gpu_scope >= 0)
+        glQueryCounter(gpu_scopes[frame][scope.gpu_scope].queries[1],
+                       GL_TIMESTAMP);
+
+    int64_t duration = now_us() - scope.start;
+    history(scope.name).add_cpu(duration / 1000.f);
+    add_trace(scope.name, scope.start, duration, 0);
+}
+
+ScopeHistory& Profiler::history(const char* name) {
+    // scope names are literals, compare pointers before strings
+    for (ScopeHistory& scope : scopes)
+        if (scope.name == name) return scope;
+    for (ScopeHistory& scope : scopes)
+        if (strcmp(scope.name, name) == 0) return scope;
+
+    scopes.emplace_back();
+    ScopeHistory& scope = scopes.back();
+    scope.name = name;
+    scope.cpu_written = scope.gpu_written = 0;
+    return scope;
+}
+
+void Profiler::print_summary(std::ostream& out) const {
+    out << "[INFO] Profile (ms)              cpu min/avg/p99"
+        << "       gpu min/avg/p99" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    for (ScopeHistory const& scope : scopes) {
+        ScopeSummary cpu = scope.cpu_summary();
+        ScopeSummary gpu = scope.gpu_summary();
+        out << "[INFO]   " << std::left << std::setw(16) << scope.name
+            << std::right << std::setw(8) << cpu.min << std::setw(8)
+            << cpu.avg << std::setw(8) << cpu.p99;
+        if (gpu.count)
+            out << "   " << std::setw(8) << gpu.min << std::setw(8) << gpu.avg
+                << std::setw(8) << gpu.p99;
+        out << std::endl;
+    }
+    if (dropped_gpu_results)
+        out << "[INFO]   " << dropped_gpu_results
+            << " GPU results were not ready in time" << std::endl;
+    out << std::defaultfloat;
+}
+
+bool Profiler::write_chrome_trace(const char* filename) const {
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "[ERROR] Failed to write trace: " << filename
+                  << std::endl;
+        return false;
+    }
+
+    // chrome://tracing and Perfetto read this array of complete events
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+           "\"args\":{\"name\":\"CPU\"}},\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,"
+           "\"args\":{\"name\":\"GPU\"}}";
+    for (TraceEvent const& event : trace) {
+        out << ",\n{\"name\":\"" << event.name
+            << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.track
+            << ",\"ts\":" << event.start << ",\"dur\":" << event.duration
+            << "}";
+    }
+    out << "\n]}\n";
+
+    std::cout << "[INFO] Wrote " << trace.size() << " trace events to "
+              << filename << std::endl;
+    return true;
+}
+
+void Profiler::destroy() {
+    if (gpu_enabled)
+        for (auto& frame_scopes : gpu_scopes)
+            for (GpuScope& scope : frame_scopes)
+                glDeleteQueries(2, scope.queries);
+    gpu_enabled = false;
+}
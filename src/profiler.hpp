@@ -0,0 +1,104 @@
+#ifndef __PROFILER_HPP
+#define __PROFILER_HPP
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// min/avg/p99 of the samples kept for a scope, in milliseconds
+struct ScopeSummary {
+    float min, avg, p99;
+    unsigned count;
+};
+
+// last HISTORY samples of one named scope
+struct ScopeHistory {
+    static const int HISTORY = 256;
+
+    const char* name;
+    float cpu_ms[HISTORY], gpu_ms[HISTORY];
+    unsigned cpu_written, gpu_written;  // total, index is written % HISTORY
+
+    void add_cpu(float ms) { cpu_ms[cpu_written++ % HISTORY] = ms; }
+    void add_gpu(float ms) { gpu_ms[gpu_written++ % HISTORY] = ms; }
+    ScopeSummary cpu_summary() const;
+    ScopeSummary gpu_summary() const;
+};
+
+// one complete event of the exported trace, times in microseconds
+struct TraceEvent {
+    const char* name;
+    int64_t start, duration;
+    int track;  // 0 CPU, 1 GPU
+};
+
+/*
+ * Nested CPU scopes timed with steady_clock and matching GPU scopes timed
+ * with GL_TIMESTAMP queries. GPU results are read FRAMES frames later and
+ * only if available, so the profiler never waits for the GPU.
+ *
+ * Timestamps are used instead of GL_TIME_ELAPSED because elapsed queries
+ * can't be nested.
+ */
+struct Profiler {
+    static const int FRAMES = 3;
+    static const int MAX_GPU_SCOPES = 32;  // per frame
+    static const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+    struct OpenScope {
+        const char* name;
+        int64_t start;
+        int gpu_scope;  // index in this frame's GpuScopes, -1 if CPU only
+    };
+
+    struct GpuScope {
+        const char* name;
+        GLuint queries[2];  // begin and end timestamps
+    };
+
+    bool gpu_enabled;
+    bool record_trace;
+    std::chrono::steady_clock::time_point origin;
+    GLint64 gpu_origin;  // GL_TIMESTAMP at origin, in nanoseconds
+
+    std::vector<OpenScope> stack;
+    GpuScope gpu_scopes[FRAMES][MAX_GPU_SCOPES];
+    int gpu_scope_count[FRAMES];
+    int frame;
+    unsigned dropped_gpu_results;  // not ready after FRAMES frames
+
+    std::vector<ScopeHistory> scopes;
+    std::vector<TraceEvent> trace;
+
+    // needs a current GL context, GPU scopes are off without timer queries
+    void init(bool record_trace);
+    // collects GPU results of the frame whose queries are about to be reused
+    void begin_frame();
+    void begin(const char* name, bool gpu);
+    void end();
+
+    ScopeHistory& history(const char* name);
+    void print_summary(std::ostream& out) const;
+    bool write_chrome_trace(const char* filename) const;
+    void destroy();
+
+   private:
+    int64_t now_us() const;
+    void add_trace(const char* name, int64_t start, int64_t duration,
+                   int track);
+};
+
+extern Profiler profiler;
+
+// times the enclosing block, e.g. ProfileScope scope("sun pass");
+struct ProfileScope {
+    ProfileScope(const char* name, bool gpu = true) {
+        profiler.begin(name, gpu);
+    }
+    ~ProfileScope() { profiler.end(); }
+};
+
+#endif  // __PROFILER_HPP
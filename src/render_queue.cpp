@@ -0,0 +1,338 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+#include <limits>
+
+#include "frame_data.hpp"
+#include "shader_manager.hpp"
+
+RenderStats render_stats;
+
+// stable counting sort by the state items bind, ascending. A scene has a
+// handful of states, so they are looked up linearly from the last one hit
+template <typename State>
+static void sort_by_state(FrameVector<DrawItem> const& items, State state,
+                          FrameVector<uint32_t>& order) {
+    struct Group {
+        uint64_t state;
+        uint32_t begin;  // counts items until the offsets are known
+    };
+    FrameVector<Group> groups;
+    FrameVector<uint32_t> group_of(items.size());
+    uint32_t group = 0;
+    for (uint32_t i = 0; i < items.size(); i++) {
+        uint64_t s = state(items[i]);
+        if (groups.empty() || groups[group].state != s) {
+            group = 0;
+            while (group < groups.size() && groups[group].state != s) group++;
+            if (group == groups.size()) groups.push_back({s, 0});
+        }
+        groups[group].begin++;
+        group_of[i] = group;
+    }
+
+    FrameVector<uint32_t> by_state(groups.size());
+    for (uint32_t g = 0; g < groups.size(); g++) by_state[g] = g;
+    std::sort(by_state.begin(), by_state.end(), [&](uint32_t a, uint32_t b) {
+        return groups[a].state < groups[b].state;
+    });
+    uint32_t offset = 0;
+    for (uint32_t g : by_state) {
+        uint32_t count = groups[g].begin;
+        groups[g].begin = offset;
+        offset += count;
+    }
+
+    order.resize(items.size());
+    for (uint32_t i = 0; i < items.size(); i++)
+        order[groups[group_of[i]].begin++] = i;
+}
+
+static GLuint depth_vao(DrawItem const& item) {
+    return item.instanced ? item.instanced->shadow_vao : item.mesh->shadow_vao;
+}
+
+void RenderQueue::prepare(JobSystem* jobs) {
+    auto update = [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            DrawItem& item = items[i];
+            // instanced items have no single bounds, an infinite sphere
+            // keeps them
+            if (!item.mesh) {
+                item.center = glm::vec3(0);
+                item.radius = std::numeric_limits<float>::infinity();
+                continue;
+            }
+            Mesh* mesh = item.mesh;
+            mesh->update_world_bounds();
+            mesh->update_normal_model();
+            // levels follow the player camera in every pass, so shadows match
+            mesh->update_lod();
+            item.center = mesh->world_center;
+            item.radius = mesh->world_radius;
+        }
+    };
+    if (jobs)
+        jobs->parallel_for(items.size(), PREPARE_BATCH, update);
+    else
+        update(0, items.size());
+
+    sort_by_state(
+        items,
+        [](DrawItem const& item) {
+            return (uint64_t)item.prog << 32 | item.tex0;
+        },
+        color_order);
+    // depth passes draw the position streams with one program for single
+    // and one for instanced draws, and no texture
+    sort_by_state(
+        items, [](DrawItem const& item) { return (uint64_t)!item.instanced; },
+        depth_order);
+}
+
+static void record_batch(void* data, size_t batch) {
+    const size_t BATCH = CommandBuffer::BATCH;
+    CommandBuffer& out = *(CommandBuffer*)data;
+    FrameVector<DrawItem> const& items = out.queue->items;
+    PassUniforms const& pass = out.pass;
+    size_t begin = batch * BATCH;
+    size_t count = std::min(BATCH, out.recorded - begin);
+    const uint32_t* order = out.order + begin;
+
+    // gathered in pass order so the plane tests still vectorize
+    float x[BATCH], y[BATCH], z[BATCH], radius[BATCH];
+    uint8_t visible[BATCH];
+    for (size_t i = 0; i < count; i++) {
+        DrawItem const& item = items[order[i]];
+        x[i] = item.center.x;
+        y[i] = item.center.y;
+        z[i] = item.center.z;
+        radius[i] = item.radius;
+    }
+    cull_spheres(out.frustum, x, y, z, radius, count, visible);
+
+    bool depth_only = pass.depth_prog != 0;
+    DrawCommand* command = out.commands.data() + begin;
+    uint32_t occluded = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!visible[i]) continue;
+        DrawItem const& item = items[order[i]];
+        if (item.instanced && item.instanced->instances.empty()) continue;
+        // boxes only, after the cheaper sphere test
+        if (pass.occlusion && item.mesh &&
+            pass.occlusion->occluded(item.mesh->bounds, item.mesh->model)) {
+            occluded++;
+            continue;
+        }
+        Mesh const& mesh = item.instanced ? *item.instanced->mesh : *item.mesh;
+
+        command->prog = item.prog;
+        command->tex0 = item.tex0;
+        command->vao = item.vao;
+        if (depth_only) {
+            command->prog = item.instanced ? pass.depth_instanced_prog
+                                           : pass.depth_prog;
+            command->tex0 = 0;
+            command->vao = depth_vao(item);
+        }
+        command->tex0_target =
+            mesh.packed ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+        command->position_step = mesh.position_step;
+        command->palette_layer = mesh.palette_layer;
+
+        // instanced transforms come from the instance buffer
+        command->instances =
+            item.instanced ? item.instanced->instances.size() : 0;
+        if (!item.instanced) {
+            command->model = mesh.model;
+            if (!depth_only) command->normal_model = mesh.normal_model;
+        }
+
+        int lod = pass.lod_bias + (item.instanced ? 0 : mesh.lod);
+        if (mesh.ebo) {
+            MeshLod const& range =
+                mesh.lods[std::min<size_t>(lod, mesh.lods.size() - 1)];
+            size_t index_size = mesh.index_type == GL_UNSIGNED_SHORT
+                                    ? sizeof(uint16_t)
+                                    : sizeof(uint32_t);
+            command->index_type = mesh.index_type;
+            command->count = range.index_count;
+            command->first = range.first_index * index_size;
+        } else {
+            command->index_type = 0;
+            command->count = mesh.vertex_count;
+            command->first = 0;
+        }
+        command++;
+    }
+    out.counts[batch] = command - (out.commands.data() + begin);
+    out.occluded[batch] = occluded;
+}
+
+void RenderQueue::record(PassUniforms const& pass, CommandBuffer& out,
+                         JobSystem* jobs, JobCounter* counter) const {
+    out.pass = pass;
+    out.frustum = extract_frustum(pass.projection * pass.view);
+    out.queue = this;
+    out.order = (pass.depth_prog ? depth_order : color_order).data();
+    out.recorded = items.size();
+
+    // only ever grown, so steady frames record without allocating
+    size_t batches =
+        (items.size() + CommandBuffer::BATCH - 1) / CommandBuffer::BATCH;
+    if (out.commands.size() < items.size()) out.commands.resize(items.size());
+    out.counts.resize(batches);
+    out.occluded.resize(batches);
+
+    for (size_t batch = 0; batch < batches; batch++) {
+        if (jobs)
+            jobs->submit(record_batch, &out, batch, *counter);
+        else
+            record_batch(&out, batch);
+    }
+}
+
+// locations replay sets, looked up once per program and again after
+// shader_manager relinks it. A scene has a handful of programs
+struct ProgramUniforms {
+    GLuint prog;
+    unsigned version;  // shader_manager.version of the locations
+    GLint model, normal_model, position_step, palette_layer;
+};
+
+static std::vector<ProgramUniforms> program_uniforms;
+
+static ProgramUniforms const& lookup_uniforms(GLuint prog) {
+    ProgramUniforms* uniforms = 0;
+    for (ProgramUniforms& cached : program_uniforms)
+        if (cached.prog == prog) uniforms = &cached;
+    if (uniforms && uniforms->version == shader_manager.version)
+        return *uniforms;
+
+    if (!uniforms) {
+        program_uniforms.push_back({prog});
+        uniforms = &program_uniforms.back();
+    }
+    uniforms->version = shader_manager.version;
+    uniforms->model = glGetUniformLocation(prog, "model");
+    uniforms->normal_model = glGetUniformLocation(prog, "normal_model");
+    uniforms->position_step = glGetUniformLocation(prog, "position_step");
+    uniforms->palette_layer = glGetUniformLocation(prog, "palette_layer");
+    return *uniforms;
+}
+
+static void draw(DrawCommand const& command) {
+    if (command.instances && command.index_type) {
+        glDrawElementsInstanced(GL_TRIANGLES, command.count,
+                                command.index_type, (void*)command.first,
+                                command.instances);
+    } else if (command.instances) {
+        glDrawArraysInstanced(GL_TRIANGLES, command.first, command.count,
+                              command.instances);
+    } else if (command.index_type) {
+        glDrawElements(GL_TRIANGLES, command.count, command.index_type,
+                       (void*)command.first);
+    } else {
+        glDrawArrays(GL_TRIANGLES, command.first, command.count);
+    }
+    render_stats.triangles +=
+        command.count / 3 * std::max<GLsizei>(command.instances, 1);
+    render_stats.draw_calls++;
+}
+
+CullStats CommandBuffer::replay() const {
+    // pass uniforms are shared by all programs through the FrameData block
+    FrameData frame = {};
+    frame.view = pass.view;
+    frame.projection = pass.projection;
+    if (pass.shadows) pass.shadows->fill(frame);
+    frame_uniforms.write(frame);
+    render_stats.uniform_uploads++;
+
+    // state left by others is unknown, so everything is bound on first use
+    GLuint bound_prog = 0, bound_tex0 = 0, bound_vao = 0;
+    bool first = true;
+    GLint modelID = -1, normal_modelID = -1;
+    // programs reading packed positions scale them by position_step
+    GLint position_stepID = -1;
+    float bound_position_step = 0;
+    // packed meshes pick their layer of the shared palette array
+    GLint palette_layerID = -1;
+    int bound_palette_layer = -1;
+
+    bool depth_only = pass.depth_prog != 0;
+    if (!depth_only) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY,
+                      pass.shadows ? pass.shadows->depth_tex : 0);
+        render_stats.texture_binds++;
+    }
+
+    unsigned visible = 0, hidden = 0;
+    for (size_t batch = 0; batch < counts.size(); batch++) {
+        const DrawCommand* command = commands.data() + batch * BATCH;
+        const DrawCommand* end = command + counts[batch];
+        visible += counts[batch];
+        hidden += occluded[batch];
+        for (; command != end; command++) {
+            if (first || command->prog != bound_prog) {
+                glUseProgram(command->prog);
+                render_stats.program_binds++;
+                bound_prog = command->prog;
+                ProgramUniforms const& uniforms = lookup_uniforms(bound_prog);
+                modelID = uniforms.model;
+                normal_modelID = uniforms.normal_model;
+                position_stepID = uniforms.position_step;
+                bound_position_step = 0;
+                palette_layerID = uniforms.palette_layer;
+                bound_palette_layer = -1;
+            }
+
+            if (position_stepID >= 0 &&
+                command->position_step != bound_position_step) {
+                glUniform1f(position_stepID, command->position_step);
+                render_stats.uniform_uploads++;
+                bound_position_step = command->position_step;
+            }
+
+            if (palette_layerID >= 0 &&
+                command->palette_layer != bound_palette_layer) {
+                glUniform1f(palette_layerID, command->palette_layer);
+                render_stats.uniform_uploads++;
+                if (bound_palette_layer >= 0 && command->tex0 == bound_tex0)
+                    render_stats.palette_switches++;
+                bound_palette_layer = command->palette_layer;
+            }
+
+            if (command->tex0 && (first || command->tex0 != bound_tex0)) {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(command->tex0_target, command->tex0);
+                render_stats.texture_binds++;
+                bound_tex0 = command->tex0;
+            }
+
+            if (first || command->vao != bound_vao) {
+                glBindVertexArray(command->vao);
+                render_stats.vao_binds++;
+                bound_vao = command->vao;
+            }
+            first = false;
+
+            if (!command->instances) {
+                glUniformMatrix4fv(modelID, 1, GL_FALSE,
+                                   glm::value_ptr(command->model));
+                render_stats.uniform_uploads++;
+                if (!depth_only) {
+                    glUniformMatrix3fv(normal_modelID, 1, GL_FALSE,
+                                       glm::value_ptr(command->normal_model));
+                    render_stats.uniform_uploads++;
+                }
+            }
+            draw(*command);
+        }
+    }
+
+    glBindVertexArray(0);
+    return {visible, (unsigned)recorded - visible - hidden, hidden};
+}
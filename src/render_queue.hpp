@@ -0,0 +1,138 @@
+#ifndef __RENDER_QUEUE_HPP
+#define __RENDER_QUEUE_HPP
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "arena.hpp"
+#include "culling.hpp"
+#include "instancing.hpp"
+#include "job_system.hpp"
+#include "mesh.hpp"
+#include "occlusion.hpp"
+#include "shadows.hpp"
+
+// GL calls issued while rendering, reset every frame
+struct RenderStats {
+    unsigned program_binds, texture_binds, vao_binds, uniform_uploads,
+        draw_calls, triangles;
+    // palette changes that were only a uniform, binds with a texture each
+    unsigned palette_switches;
+
+    void reset() { *this = RenderStats{}; }
+    unsigned state_changes() const {
+        return program_binds + texture_binds + vao_binds + uniform_uploads;
+    }
+};
+
+extern RenderStats render_stats;
+
+// uniforms shared by every draw in a pass
+struct PassUniforms {
+    glm::mat4 view, projection;
+    // sampled from texture unit 1, null draws without shadows
+    ShadowCascades const* shadows;
+    // position only programs replacing the mesh ones, set for depth passes
+    GLuint depth_prog, depth_instanced_prog;
+    // levels coarser than chosen for lod_view, e.g. for shadow casters
+    int lod_bias;
+    // depth of earlier frames of this view, null draws all items inside
+    // the frustum. Instanced items are never tested
+    HiZBuffer const* occlusion;
+};
+
+struct DrawItem {
+    GLuint prog, tex0, vao;    // prog and tex0 are the sort key
+    Mesh* mesh;                // set for single draws
+    InstancedMesh* instanced;  // set for instanced draws
+    // world bounding sphere, filled by prepare()
+    glm::vec3 center;
+    float radius;
+};
+
+/*
+ * One draw with everything replay needs copied out of the mesh, so the GL
+ * thread never reads the scene and recording never calls GL.
+ */
+struct DrawCommand {
+    glm::mat4 model;
+    glm::mat3 normal_model;  // not set in depth passes
+    GLuint prog, tex0, vao;
+    GLenum tex0_target;  // GL_TEXTURE_2D_ARRAY for palette arrays
+    float position_step;
+    int palette_layer;
+    // count indicies from byte offset first, or count verticies from vertex
+    // first when index_type is 0
+    GLenum index_type;
+    GLsizei count;
+    size_t first;
+    GLsizei instances;  // 0 for a single draw with model
+};
+
+struct RenderQueue;
+
+/*
+ * Draws of one pass, recorded from a RenderQueue on any thread and replayed
+ * on the GL thread. Meant to be kept across frames, so its arrays stop
+ * growing after the first ones.
+ */
+struct CommandBuffer {
+    // items culled and recorded by one job
+    static const size_t BATCH = 256;
+
+    PassUniforms pass;
+    Frustum frustum;
+    const RenderQueue* queue;  // recorded from
+    const uint32_t* order;     // items of queue in the order of this pass
+    size_t recorded;           // items looked at
+    // batch b recorded counts[b] commands starting at commands[b * BATCH]
+    std::vector<DrawCommand> commands;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> occluded;  // of batch b, see PassUniforms
+
+    // GL thread, returns how many items survived culling
+    CullStats replay() const;
+};
+
+/*
+ * Collects meshes for the passes of a frame. prepare() brings their bounds,
+ * normal matrices and levels of detail up to date and sorts the items by
+ * program -> texture once, every mesh has a VAO of its own so items of one
+ * state keep the order they were pushed in. After that the queue is read:
+ * record() drops items outside a pass frustum, and with pass occlusion the
+ * ones hidden behind its depth, and copies the rest into a CommandBuffer,
+ * in batches that run as jobs, so all passes record on all cores at once.
+ * Replay then changes GL state only at transitions and
+ * writes the pass uniforms once into the FrameData uniform buffer.
+ *
+ * Items live in the frame arena, so a queue must not outlive its frame.
+ */
+struct RenderQueue {
+    // levels of the items updated by one job
+    static const size_t PREPARE_BATCH = 1024;
+
+    FrameVector<DrawItem> items;
+    // item indices grouped by the state color and depth passes bind
+    FrameVector<uint32_t> color_order, depth_order;
+
+    void push(Mesh* mesh) {
+        items.push_back({mesh->prog, mesh->tex0, mesh->vao, mesh, 0});
+    }
+    void push(InstancedMesh* instanced) {
+        items.push_back({instanced->prog, instanced->mesh->tex0,
+                         instanced->vao, 0, instanced});
+    }
+    // after the last push, a mesh must not be pushed twice and must not
+    // change until the commands recorded from it are replayed
+    void prepare(JobSystem* jobs = 0);
+    // batches become jobs on counter or, without jobs, run right away. out
+    // is ready to replay once the counter is done
+    void record(PassUniforms const& pass, CommandBuffer& out,
+                JobSystem* jobs = 0, JobCounter* counter = 0) const;
+};
+
+#endif  // __RENDER_QUEUE_HPP
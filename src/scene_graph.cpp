@@ -0,0 +1,123 @@
+#include "scene_graph.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+
+// translation * rotation * scale, without building the three matrices
+static glm::mat4 compose(glm::vec3 t, glm::quat q, glm::vec3 s) {
+    glm::mat3 r = glm::mat3_cast(q);
+    glm::mat4 m;
+    m[0] = glm::vec4(r[0] * s.x, 0);
+    m[1] = glm::vec4(r[1] * s.y, 0);
+    m[2] = glm::vec4(r[2] * s.z, 0);
+    m[3] = glm::vec4(t, 1);
+    return m;
+}
+
+SceneGraph::SceneGraph() : order_dirty(false), updated(0) {}
+
+uint32_t SceneGraph::add(uint32_t parent_node) {
+    uint32_t node = parent.size();
+    parent.push_back(parent_node);
+    depth.push_back(parent_node == NO_PARENT ? 0 : depth[parent_node] + 1);
+    position.push_back(glm::vec3(0));
+    rotation.push_back(glm::quat(1, 0, 0, 0));
+    scale.push_back(glm::vec3(1));
+    local.push_back(glm::mat4(1));
+    world.push_back(glm::mat4(1));
+    normal.push_back(glm::mat3(1));
+    dirty.push_back(1);
+    changed.push_back(0);
+    order_dirty = true;
+    return node;
+}
+
+void SceneGraph::set_position(uint32_t node, glm::vec3 p) {
+    position[node] = p;
+    dirty[node] = 1;
+}
+
+void SceneGraph::set_rotation(uint32_t node, glm::quat q) {
+    rotation[node] = q;
+    dirty[node] = 1;
+}
+
+void SceneGraph::set_scale(uint32_t node, glm::vec3 s) {
+    scale[node] = s;
+    dirty[node] = 1;
+}
+
+void SceneGraph::set_local(uint32_t node, glm::vec3 p, glm::quat q,
+                           glm::vec3 s) {
+    position[node] = p;
+    rotation[node] = q;
+    scale[node] = s;
+    dirty[node] = 1;
+}
+
+void SceneGraph::rebuild_order() {
+    // counting sort by depth, ids stay ascending within a level
+    uint32_t levels = 0;
+    for (uint32_t d : depth) levels = std::max(levels, d + 1);
+    level_begin.assign(levels + 1, 0);
+    for (uint32_t d : depth) level_begin[d + 1]++;
+    for (uint32_t d = 0; d < levels; d++)
+        level_begin[d + 1] += level_begin[d];
+
+    order.resize(parent.size());
+    std::vector<uint32_t> next(level_begin.begin(), level_begin.end() - 1);
+    for (uint32_t node = 0; node < parent.size(); node++)
+        order[next[depth[node]]++] = node;
+    order_dirty = false;
+}
+
+unsigned SceneGraph::update_range(size_t begin, size_t end) {
+    unsigned count = 0;
+    for (size_t i = begin; i < end; i++) {
+        uint32_t node = order[i];
+        uint32_t p = parent[node];
+        // parents are a level up, so their flags are final already
+        bool parent_changed = p != NO_PARENT && changed[p];
+        if (!dirty[node] && !parent_changed) continue;
+
+        if (dirty[node])
+            local[node] =
+                compose(position[node], rotation[node], scale[node]);
+        world[node] = p == NO_PARENT ? local[node] : world[p] * local[node];
+        normal[node] = glm::transpose(glm::inverse(glm::mat3(world[node])));
+        dirty[node] = 0;
+        changed[node] = 1;
+        count++;
+    }
+    return count;
+}
+
+void SceneGraph::update(ThreadPool* pool) {
+    if (order_dirty) rebuild_order();
+    if (!changed.empty()) memset(changed.data(), 0, changed.size());
+    updated = 0;
+
+    size_t workers = pool ? pool->size() + 1 : 1;
+    for (size_t level = 0; level + 1 < level_begin.size(); level++) {
+        size_t begin = level_begin[level], end = level_begin[level + 1];
+        size_t jobs = std::min(workers, (end - begin) / MIN_BATCH);
+        if (jobs <= 1) {
+            updated += update_range(begin, end);
+            continue;
+        }
+
+        // the caller takes the last batch, then waits for the level
+        size_t batch = (end - begin + jobs - 1) / jobs;
+        std::vector<std::future<unsigned>> results;
+        results.reserve(jobs - 1);
+        for (size_t job = 0; job + 1 < jobs; job++) {
+            size_t job_begin = begin + job * batch;
+            results.push_back(pool->submit([this, job_begin, batch] {
+                return update_range(job_begin, job_begin + batch);
+            }));
+        }
+        updated += update_range(begin + (jobs - 1) * batch, end);
+        for (auto& result : results) updated += result.get();
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef __SCENE_GRAPH_HPP
+#define __SCENE_GRAPH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+const uint32_t NO_PARENT = ~0u;
+
+/*
+ * Transform hierarchy kept as parallel arrays indexed by node id. Setters
+ * only store the local translation, rotation and scale and mark the node
+ * dirty, update() recomputes world and normal matrices of dirty nodes and
+ * everything below them, once per frame however often they were touched.
+ *
+ * Nodes are updated by depth, all nodes of one depth are independent of
+ * each other, so big levels are split across a thread pool.
+ */
+struct SceneGraph {
+    // levels smaller than this are not worth a pool job
+    static const size_t MIN_BATCH = 4096;
+
+    std::vector<uint32_t> parent;  // NO_PARENT for roots
+    std::vector<uint32_t> depth;   // 0 for roots
+    std::vector<glm::vec3> position, scale;
+    std::vector<glm::quat> rotation;
+    std::vector<glm::mat4> local, world;
+    std::vector<glm::mat3> normal;  // transpose(inverse(world)), cached
+    std::vector<uint8_t> dirty;     // local transform set since update()
+    std::vector<uint8_t> changed;   // world recomputed by the last update()
+
+    // node ids sorted by depth, level d is order[level_begin[d]] up to
+    // order[level_begin[d + 1]], rebuilt when nodes were added
+    std::vector<uint32_t> order, level_begin;
+    bool order_dirty;
+
+    unsigned updated;  // nodes recomputed by the last update()
+
+    SceneGraph();
+
+    // parent must already exist, so parents always have smaller ids
+    uint32_t add(uint32_t parent = NO_PARENT);
+    size_t size() const { return parent.size(); }
+
+    void set_position(uint32_t node, glm::vec3 p);
+    void set_rotation(uint32_t node, glm::quat q);
+    void set_scale(uint32_t node, glm::vec3 s);
+    void set_local(uint32_t node, glm::vec3 p, glm::quat q, glm::vec3 s);
+
+    // without a pool, or with small levels, everything runs on the caller
+    void update(ThreadPool* pool = 0);
+
+   private:
+    void rebuild_order();
+    // recomputes dirty nodes of order[begin] up to order[end], returns how
+    // many
+    unsigned update_range(size_t begin, size_t end);
+};
+
+#endif  // __SCENE_GRAPH_HPP
@@ -0,0 +1,363 @@
+#include "shader_manager.hpp"
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string_view>
+
+#include "frame_data.hpp"
+#include "util.hpp"
+
+ShaderManager shader_manager;
+
+// ARB_get_program_binary, core since 4.1 and not in the 3.3 loader
+const GLenum PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;
+const GLenum PROGRAM_BINARY_LENGTH = 0x8741;
+const GLenum NUM_PROGRAM_BINARY_FORMATS = 0x87FE;
+
+typedef void(APIENTRYP GetProgramBinaryProc)(GLuint, GLsizei, GLsizei*,
+                                             GLenum*, void*);
+typedef void(APIENTRYP ProgramBinaryProc)(GLuint, GLenum, const void*,
+                                          GLsizei);
+typedef void(APIENTRYP ProgramParameteriProc)(GLuint, GLenum, GLint);
+
+static GetProgramBinaryProc get_program_binary;
+static ProgramBinaryProc program_binary;
+static ProgramParameteriProc program_parameteri;
+
+const char BINARY_MAGIC[4] = {'S', 'H', 'D', 'B'};
+
+struct BinaryHeader {
+    char magic[4];
+    uint32_t format;
+    uint32_t length;
+};
+
+static bool has_extension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+        if (!strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name))
+            return true;
+    return false;
+}
+
+/*
+ * Source of path with every line #include "file" replaced by that file,
+ * relative to the directory of path. Files are pulled in once and added to
+ * includes, #line directives keep compiler errors pointing at the right
+ * file: string 0 is path, string n the n-th entry of includes.
+ */
+static std::string load_source(std::string const& path,
+                               std::vector<std::string>& includes,
+                               size_t string_number = 0) {
+    const std::string_view DIRECTIVE = "#include \"";
+    std::string source = load_whole_file(path.c_str());
+    std::string dir = path.substr(0, path.find_last_of('/') + 1);
+
+    std::string out;
+    size_t line_number = 1;
+    for (size_t begin = 0; begin < source.size(); line_number++) {
+        size_t end = std::min(source.find('\n', begin), source.size());
+        std::string_view line(source.data() + begin, end - begin);
+        begin = end + 1;
+
+        if (line.substr(0, DIRECTIVE.size()) != DIRECTIVE ||
+            line.size() <= DIRECTIVE.size() || line.back() != '"') {
+            out.append(line);
+            out += '\n';
+            continue;
+        }
+        std::string name =
+            dir + std::string(line.substr(DIRECTIVE.size(),
+                                          line.size() - DIRECTIVE.size() - 1));
+        if (std::find(includes.begin(), includes.end(), name) !=
+            includes.end())
+            continue;
+        includes.push_back(name);
+        out += "#line 1 " + std::to_string(includes.size()) + "\n";
+        out += load_source(name, includes, includes.size());
+        out += "#line " + std::to_string(line_number + 1) + " " +
+               std::to_string(string_number) + "\n";
+    }
+    return out;
+}
+
+static bool check_shader(GLuint shader, std::string const& path) {
+    GLint ok = GL_FALSE, log_size = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_size);
+    if (log_size > 1) {
+        std::vector<char> errmsg(log_size + 1, 0);
+        glGetShaderInfoLog(shader, log_size, 0, errmsg.data());
+        std::cerr << (ok ? "[WARN] " : "[ERROR] ") << path << ":\n"
+                  << errmsg.data() << std::endl;
+    }
+    return ok;
+}
+
+static bool check_program(GLuint prog, std::string const& name) {
+    GLint ok = GL_FALSE, log_size = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &log_size);
+    if (log_size > 1) {
+        std::vector<char> errmsg(log_size + 1, 0);
+        glGetProgramInfoLog(prog, log_size, 0, errmsg.data());
+        std::cerr << (ok ? "[WARN] " : "[ERROR] ") << name << ":\n"
+                  << errmsg.data() << std::endl;
+    }
+    return ok;
+}
+
+// state lost on every link, same conventions as Mesh
+static void setup_program(GLuint prog) {
+    GLuint frame_data_index = glGetUniformBlockIndex(prog, "FrameData");
+    if (frame_data_index != GL_INVALID_INDEX)
+        glUniformBlockBinding(prog, frame_data_index, FRAME_DATA_BINDING);
+
+    glUseProgram(prog);
+    glUniform1i(glGetUniformLocation(prog, "tex0"), 0);
+    glUniform1i(glGetUniformLocation(prog, "tex1"), 1);
+    glUseProgram(0);
+}
+
+void ShaderManager::init(GLADloadproc load, const char* cache_dir) {
+    this->cache_dir = cache_dir;
+    version = 0;
+    inotify_fd = -1;
+    compiled_stages = linked_programs = binary_hits = 0;
+
+    driver_id = std::string((const char*)glGetString(GL_VENDOR)) + "\n" +
+                (const char*)glGetString(GL_RENDERER) + "\n" +
+                (const char*)glGetString(GL_VERSION);
+
+    bool core = GLVersion.major > 4 ||
+                (GLVersion.major == 4 && GLVersion.minor >= 1);
+    if (core || has_extension("GL_ARB_get_program_binary")) {
+        get_program_binary = (GetProgramBinaryProc)load("glGetProgramBinary");
+        program_binary = (ProgramBinaryProc)load("glProgramBinary");
+        program_parameteri =
+            (ProgramParameteriProc)load("glProgramParameteri");
+    }
+
+    // drivers may expose the entry points but support no format
+    GLint formats = 0;
+    if (get_program_binary)
+        glGetIntegerv(NUM_PROGRAM_BINARY_FORMATS, &formats);
+    binary_supported = get_program_binary && program_binary &&
+                       program_parameteri && formats > 0;
+
+    if (binary_supported)
+        mkdir(cache_dir, 0755);
+    else
+        std::cout << "[INFO] No program binaries, shaders are compiled "
+                     "from source"
+                  << std::endl;
+}
+
+GLuint ShaderManager::get(const char* vertex_path,
+                          const char* fragment_path) {
+    for (Program const& program : programs)
+        if (program.vertex_path == vertex_path &&
+            program.fragment_path == fragment_path)
+            return program.prog;
+
+    Program program = {vertex_path, fragment_path, glCreateProgram(), {}};
+    build(program, program.prog);
+    programs.push_back(program);
+    return program.prog;
+}
+
+ShaderManager::Stage& ShaderManager::stage(std::string const& path,
+                                           GLenum type,
+                                           std::string const& source) {
+    uint64_t hash = hash_bytes(source);
+    auto it = stages.find(path);
+    if (it != stages.end() && it->second.hash == hash) return it->second;
+
+    Stage& stage = stages[path];
+    if (it != stages.end()) glDeleteShader(stage.shader);
+
+    const char* src = source.c_str();
+    stage.shader = glCreateShader(type);
+    glShaderSource(stage.shader, 1, &src, 0);
+    glCompileShader(stage.shader);
+    stage.hash = hash;
+    stage.ok = check_shader(stage.shader, path);
+    compiled_stages++;
+    return stage;
+}
+
+bool ShaderManager::build(Program& program, GLuint target) {
+    // each stage pulls in its own copy of a shared file
+    std::vector<std::string> fragment_includes;
+    program.includes.clear();
+    std::string vertex_source =
+        load_source(program.vertex_path, program.includes);
+    std::string fragment_source =
+        load_source(program.fragment_path, fragment_includes);
+    program.includes.insert(program.includes.end(),
+                            fragment_includes.begin(),
+                            fragment_includes.end());
+
+    uint64_t key = hash_bytes(driver_id + '\0' + vertex_source + '\0' +
+                              fragment_source);
+    if (binary_supported && load_binary(target, key)) {
+        setup_program(target);
+        binary_hits++;
+        return true;
+    }
+
+    Stage& vs = stage(program.vertex_path, GL_VERTEX_SHADER, vertex_source);
+    Stage& fs =
+        stage(program.fragment_path, GL_FRAGMENT_SHADER, fragment_source);
+    if (!vs.ok || !fs.ok) return false;
+
+    if (binary_supported)
+        program_parameteri(target, PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(target, vs.shader);
+    glAttachShader(target, fs.shader);
+    glLinkProgram(target);
+    glDetachShader(target, vs.shader);
+    glDetachShader(target, fs.shader);
+    linked_programs++;
+
+    if (!check_program(target,
+                       program.vertex_path + " + " + program.fragment_path))
+        return false;
+
+    if (binary_supported) save_binary(target, key);
+    setup_program(target);
+    return true;
+}
+
+std::string ShaderManager::binary_path(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+    return cache_dir + name;
+}
+
+bool ShaderManager::load_binary(GLuint prog, uint64_t key) {
+    // a missing file is the usual cache miss, so no error here
+    std::ifstream in(binary_path(key), std::ios::binary);
+    if (!in) return false;
+    std::string data((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(BinaryHeader)) return false;
+
+    BinaryHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, BINARY_MAGIC, 4) ||
+        header.length != data.size() - sizeof(header))
+        return false;
+
+    // a driver update may reject old binaries, then we link from source
+    program_binary(prog, header.format, data.data() + sizeof(header),
+                   header.length);
+    GLint ok = GL_FALSE;
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    return ok;
+}
+
+void ShaderManager::save_binary(GLuint prog, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(prog, PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    BinaryHeader header;
+    memcpy(header.magic, BINARY_MAGIC, 4);
+    header.length = length;
+    std::vector<char> binary(length);
+    get_program_binary(prog, length, 0, &header.format, binary.data());
+
+    // written next to the final file and renamed, readers never see half
+    std::string path = binary_path(key);
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary);
+        out.write((const char*)&header, sizeof(header));
+        out.write(binary.data(), binary.size());
+        if (!out) return;
+    }
+    rename(tmp_path.c_str(), path.c_str());
+}
+
+void ShaderManager::watch(const char* dir) {
+#ifdef __linux__
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0 ||
+        inotify_add_watch(inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) <
+            0) {
+        std::cerr << "[WARN] Can't watch " << dir << " for shader changes"
+                  << std::endl;
+        return;
+    }
+    watched_dir = dir;
+    std::cout << "[INFO] Watching " << dir << " for shader changes"
+              << std::endl;
+#endif
+}
+
+void ShaderManager::poll() {
+#ifdef __linux__
+    if (inotify_fd < 0) return;
+
+    std::vector<std::string> changed;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t size;
+    while ((size = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + size;) {
+            inotify_event* event = (inotify_event*)p;
+            if (event->len) changed.push_back(watched_dir + "/" + event->name);
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+    if (changed.empty()) return;
+
+    for (Program& program : programs) {
+        bool dirty = false;
+        for (std::string const& path : changed)
+            dirty |= path == program.vertex_path ||
+                     path == program.fragment_path ||
+                     std::find(program.includes.begin(),
+                               program.includes.end(),
+                               path) != program.includes.end();
+        if (!dirty) continue;
+
+        // link a scratch program first, a broken edit keeps the old one
+        GLuint scratch = glCreateProgram();
+        bool ok = build(program, scratch);
+        glDeleteProgram(scratch);
+        if (!ok) {
+            std::cerr << "[ERROR] Keeping previous " << program.vertex_path
+                      << " + " << program.fragment_path << std::endl;
+            continue;
+        }
+
+        build(program, program.prog);
+        version++;
+        std::cout << "[INFO] Reloaded " << program.vertex_path << " + "
+                  << program.fragment_path << std::endl;
+    }
+#endif
+}
+
+void ShaderManager::destroy() {
+#ifdef __linux__
+    if (inotify_fd >= 0) close(inotify_fd);
+    inotify_fd = -1;
+#endif
+    for (Program const& program : programs) glDeleteProgram(program.prog);
+    for (auto const& entry : stages) glDeleteShader(entry.second.shader);
+    programs.clear();
+    stages.clear();
+}
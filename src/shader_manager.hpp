@@ -0,0 +1,73 @@
+#ifndef __SHADER_MANAGER_HPP
+#define __SHADER_MANAGER_HPP
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Programs keyed by (vertex, fragment) file path. Every stage is compiled
+ * once and shared by all programs using it. Linked programs are stored as
+ * driver binaries in cache_dir when ARB_get_program_binary is available,
+ * keyed by the driver strings and both sources.
+ *
+ * Sources may #include "file" relative to their own directory, e.g. the
+ * shared lighting of shaders/lighting.glsl.
+ *
+ * With watch() changed files are reloaded by poll(). A program is relinked
+ * into the same GL name, so ids held by meshes stay valid; version is bumped
+ * so uniform locations can be looked up again.
+ */
+struct ShaderManager {
+    struct Stage {
+        GLuint shader;
+        uint64_t hash;  // of the source it was compiled from
+        bool ok;
+    };
+
+    struct Program {
+        std::string vertex_path, fragment_path;
+        GLuint prog;
+        // files pulled in by #include, a change to one reloads the program
+        std::vector<std::string> includes;
+    };
+
+    std::unordered_map<std::string, Stage> stages;  // by file path
+    std::vector<Program> programs;
+    unsigned version;  // bumped whenever a program is relinked
+
+    std::string cache_dir;
+    std::string driver_id;  // vendor, renderer and version strings
+    bool binary_supported;
+
+    int inotify_fd;
+    std::string watched_dir;
+
+    // counters for the startup log
+    unsigned compiled_stages, linked_programs, binary_hits;
+
+    // load is used for the program binary entry points, GL 3.3 lacks them
+    void init(GLADloadproc load, const char* cache_dir = ".shadercache");
+    // compiles and links on first use, later calls return the same program
+    GLuint get(const char* vertex_path, const char* fragment_path);
+    // reload programs when files in dir change, see poll()
+    void watch(const char* dir);
+    // non blocking, call once per frame
+    void poll();
+    void destroy();
+
+   private:
+    bool build(Program& program, GLuint target);
+    Stage& stage(std::string const& path, GLenum type,
+                 std::string const& source);
+    bool load_binary(GLuint prog, uint64_t key);
+    void save_binary(GLuint prog, uint64_t key);
+    std::string binary_path(uint64_t key) const;
+};
+
+extern ShaderManager shader_manager;
+
+#endif  // __SHADER_MANAGER_HPP
@@ -0,0 +1,120 @@
+#include "shadows.hpp"
+
+#include <cassert>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/matrix.hpp>
+
+// blend of logarithmic and uniform splits, 1 is fully logarithmic
+const float SPLIT_LAMBDA = 0.75f;
+// casters this far towards the sun from a slice still land in its map
+const float CASTER_MARGIN = 50.f;
+
+void ShadowCascades::init(int size, float max_distance) {
+    this->size = size;
+    this->max_distance = max_distance;
+
+    glGenTextures(1, &depth_tex);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depth_tex);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size,
+                 SHADOW_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // depth only, nothing reads a color target of the sun
+    glGenFramebuffers(SHADOW_CASCADES, fbos);
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                  depth_tex, 0, i);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+               GL_FRAMEBUFFER_COMPLETE);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowCascades::update(glm::mat4 const& camera_view,
+                            glm::mat4 const& camera_projection,
+                            glm::vec3 light_direction) {
+    // near and far planes back from the perspective matrix
+    float near = camera_projection[3][2] / (camera_projection[2][2] - 1);
+    float far = camera_projection[3][2] / (camera_projection[2][2] + 1);
+    float distance = glm::min(max_distance, far);
+
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        float t = (i + 1.f) / SHADOW_CASCADES;
+        float log_split = near * glm::pow(distance / near, t);
+        float uniform_split = near + (distance - near) * t;
+        splits[i] = glm::mix(uniform_split, log_split, SPLIT_LAMBDA);
+    }
+
+    // world space rays through the frustum corners, from near to far plane
+    glm::mat4 inverse = glm::inverse(camera_projection * camera_view);
+    glm::vec3 ray_start[4], ray_end[4];
+    for (int c = 0; c < 4; c++) {
+        glm::vec2 ndc = {c & 1 ? 1.f : -1.f, c & 2 ? 1.f : -1.f};
+        glm::vec4 a = inverse * glm::vec4(ndc.x, ndc.y, -1, 1);
+        glm::vec4 b = inverse * glm::vec4(ndc.x, ndc.y, 1, 1);
+        ray_start[c] = glm::vec3(a) / a.w;
+        ray_end[c] = glm::vec3(b) / b.w;
+    }
+
+    glm::vec3 up = glm::abs(light_direction.y) > 0.99f ? glm::vec3(1, 0, 0)
+                                                       : glm::vec3(0, 1, 0);
+    float slice_near = near;
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        // view depth grows linearly along each ray
+        glm::vec3 corners[8];
+        for (int c = 0; c < 4; c++) {
+            glm::vec3 ray = ray_end[c] - ray_start[c];
+            corners[c] =
+                ray_start[c] + ray * ((slice_near - near) / (far - near));
+            corners[c + 4] =
+                ray_start[c] + ray * ((splits[i] - near) / (far - near));
+        }
+        slice_near = splits[i];
+
+        // a sphere keeps the projection size constant as the camera turns
+        glm::vec3 center(0);
+        for (glm::vec3 const& corner : corners) center += corner;
+        center = center / 8.f;
+        float radius = 0;
+        for (glm::vec3 const& corner : corners)
+            radius = glm::max(radius, glm::distance(corner, center));
+        radius = glm::ceil(radius * 16) / 16;
+
+        glm::vec3 eye = center - light_direction * (radius + CASTER_MARGIN);
+        views[i] = glm::lookAt(eye, center, up);
+        projections[i] = glm::ortho(-radius, radius, -radius, radius, 0.f,
+                                    2 * radius + CASTER_MARGIN);
+
+        // snap to whole texels so shadows don't shimmer while moving
+        glm::mat4 shadow = projections[i] * views[i];
+        glm::vec4 origin = shadow * glm::vec4(0, 0, 0, 1) * (size * 0.5f);
+        glm::vec4 offset = (glm::round(origin) - origin) * (2.f / size);
+        projections[i][3][0] += offset.x;
+        projections[i][3][1] += offset.y;
+    }
+}
+
+void ShadowCascades::bind(int cascade) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbos[cascade]);
+    glViewport(0, 0, size, size);
+}
+
+void ShadowCascades::fill(FrameData& data) const {
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        data.sun_matrices[i] = projections[i] * views[i];
+        data.cascade_splits[i] = splits[i];
+    }
+    data.cascade_count = SHADOW_CASCADES;
+}
+
+void ShadowCascades::destroy() {
+    glDeleteFramebuffers(SHADOW_CASCADES, fbos);
+    glDeleteTextures(1, &depth_tex);
+}
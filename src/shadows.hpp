@@ -0,0 +1,37 @@
+#ifndef __SHADOWS_HPP
+#define __SHADOWS_HPP
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "frame_data.hpp"
+
+/*
+ * Cascaded shadow maps for the sun. The camera frustum up to max_distance is
+ * split into SHADOW_CASCADES slices, each one covered by an ortho projection
+ * around the bounding sphere of the slice and rendered into one layer of a
+ * depth texture array.
+ */
+struct ShadowCascades {
+    int size;            // texels per side of every layer
+    float max_distance;  // view distance covered by the last cascade
+    GLuint depth_tex;    // GL_TEXTURE_2D_ARRAY, a layer per cascade
+    GLuint fbos[SHADOW_CASCADES];
+
+    glm::mat4 views[SHADOW_CASCADES], projections[SHADOW_CASCADES];
+    float splits[SHADOW_CASCADES];  // view space far distance of each slice
+
+    void init(int size, float max_distance);
+    // refits cascades to the camera, direction points from the sun
+    void update(glm::mat4 const& camera_view,
+                glm::mat4 const& camera_projection,
+                glm::vec3 light_direction);
+    // binds the framebuffer and viewport of cascade
+    void bind(int cascade);
+    // stores matrices and splits read by calculate_shadows in shaders
+    void fill(FrameData& data) const;
+    void destroy();
+};
+
+#endif  // __SHADOWS_HPP
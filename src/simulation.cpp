@@ -0,0 +1,165 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+static const float PI = 3.1415926536;
+
+static const Simulation::Clock::duration TICK_DURATION =
+    std::chrono::duration_cast<Simulation::Clock::duration>(
+        std::chrono::duration<float>(SIM_TICK));
+
+SimState lerp(SimState const& a, SimState const& b, float t) {
+    SimState state = b;
+    state.time = glm::mix(a.time, b.time, t);
+    state.camera_position = glm::mix(a.camera_position, b.camera_position, t);
+    state.camera_pitch = glm::mix(a.camera_pitch, b.camera_pitch, t);
+    state.camera_yaw = glm::mix(a.camera_yaw, b.camera_yaw, t);
+    state.wand_rotation = glm::mix(a.wand_rotation, b.wand_rotation, t);
+    return state;
+}
+
+Simulation::Simulation()
+    : path(0), record(0), running(false), input(), ticks(0), dropped(0) {
+    tick_history = {};
+    tick_history.name = "sim tick";
+}
+
+Simulation::~Simulation() { stop(); }
+
+void Simulation::reset(SimState const& state) {
+    previous = current = state;
+    current_due = Clock::now();
+    // growing the keys on the tick thread would allocate in steady frames
+    if (record) record->keys.reserve(record->keys.size() + SIM_RECORD_TICKS);
+}
+
+void Simulation::start() {
+    running = true;
+    thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    wake.notify_all();
+    if (thread.joinable()) thread.join();
+}
+
+void Simulation::step() {
+    std::unique_lock<std::mutex> lock(mutex);
+    tick(lock, Clock::now());
+}
+
+void Simulation::set_input(bool up, bool down, bool left, bool right,
+                           glm::vec2 mouse_delta) {
+    std::lock_guard<std::mutex> lock(mutex);
+    input.up = up;
+    input.down = down;
+    input.left = left;
+    input.right = right;
+    input.look += mouse_delta;
+}
+
+SimState Simulation::sample(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running) return current;
+    // current became due t ticks ago, previous one tick before it
+    float t = std::chrono::duration<float>(now - current_due).count() /
+              SIM_TICK;
+    return lerp(previous, current, glm::clamp(t, 0.f, 1.f));
+}
+
+void Simulation::print_summary(std::ostream& out) {
+    // copied out, so the tick thread doesn't wait on the stream
+    ScopeSummary summary;
+    unsigned tick_count, dropped_ticks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        summary = tick_history.cpu_summary();
+        tick_count = ticks;
+        dropped_ticks = dropped;
+    }
+    out << "[INFO] Simulation: " << tick_count << " ticks at "
+        << 1 / SIM_TICK << " Hz, " << dropped_ticks
+        << " dropped, tick min/avg/p99 " << std::fixed
+        << std::setprecision(3) << summary.min << "/" << summary.avg << "/"
+        << summary.p99 << " ms" << std::defaultfloat << std::endl;
+}
+
+void Simulation::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    Clock::time_point due = Clock::now() + TICK_DURATION;
+    while (running) {
+        if (wake.wait_until(lock, due, [this] { return !running; })) break;
+
+        int steps = 0;
+        while (running && Clock::now() >= due && steps < SIM_MAX_STEPS) {
+            tick(lock, due);
+            due += TICK_DURATION;
+            steps++;
+        }
+
+        // too far behind, the game slows down instead of spiralling
+        Clock::time_point now = Clock::now();
+        if (now >= due) {
+            unsigned behind = (now - due) / TICK_DURATION + 1;
+            dropped += behind;
+            due += behind * TICK_DURATION;
+        }
+    }
+}
+
+void Simulation::tick(std::unique_lock<std::mutex>& lock,
+                      Clock::time_point due) {
+    SimState state = current;
+    SimInput tick_input = input;
+    input.look = glm::vec2(0);
+    lock.unlock();
+
+    Clock::time_point start = Clock::now();
+    SimState next = advance(state, tick_input);
+    if (record)
+        record->keys.push_back({next.time, next.camera_position,
+                                next.camera_pitch, next.camera_yaw});
+    float ms = std::chrono::duration<float, std::milli>(Clock::now() - start)
+                   .count();
+
+    lock.lock();
+    previous = current;
+    current = next;
+    current_due = due;
+    tick_history.add_cpu(ms);
+    ticks++;
+}
+
+SimState Simulation::advance(SimState const& state,
+                             SimInput const& input) const {
+    SimState next = state;
+    next.tick++;
+    next.time += SIM_TICK;
+    next.wand_rotation += PI * SIM_TICK;
+
+    // the camera where the path has it at the time of the new tick
+    if (path) {
+        CameraKey key = path->sample(next.time);
+        next.camera_position = key.position;
+        next.camera_pitch = key.pitch;
+        next.camera_yaw = key.yaw;
+    } else {
+        float yaw = state.camera_yaw;
+        glm::vec3 fd = {glm::sin(yaw), 0, glm::cos(yaw)};
+        glm::vec3 rt = glm::cross({0, 1, 0}, fd);
+        float step = CAMERA_SPEED * SIM_TICK;
+        if (input.up) next.camera_position -= fd * step;
+        if (input.down) next.camera_position += fd * step;
+        if (input.left) next.camera_position -= rt * step;
+        if (input.right) next.camera_position += rt * step;
+        next.camera_yaw -= input.look.x * CAMERA_SENSITIVITY;
+        next.camera_pitch -= input.look.y * CAMERA_SENSITIVITY;
+        next.camera_pitch = glm::clamp(next.camera_pitch, -PI / 4, PI / 4);
+    }
+    return next;
+}
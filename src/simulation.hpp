@@ -0,0 +1,98 @@
+#ifndef __SIMULATION_HPP
+#define __SIMULATION_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+#include "camera_path.hpp"
+#include "profiler.hpp"
+
+const float SIM_TICK = 1.f / 60;
+// ticks run back to back to catch up after a stall, the rest is dropped
+const int SIM_MAX_STEPS = 5;
+const float CAMERA_SPEED = 10;           // units per second
+const float CAMERA_SENSITIVITY = 0.01f;  // radians per pixel
+// keys reserved for Simulation::record, ten minutes of ticks
+const int SIM_RECORD_TICKS = 10 * 60 * 60;
+
+// everything rendering takes from one tick
+struct SimState {
+    uint64_t tick;
+    float time;  // simulated seconds
+    glm::vec3 camera_position;
+    float camera_pitch, camera_yaw;
+    float wand_rotation;
+};
+
+// angles are never wrapped, so blending them takes the short way
+SimState lerp(SimState const& a, SimState const& b, float t);
+
+// keys held and mouse movement since the last tick
+struct SimInput {
+    bool up, down, left, right;
+    glm::vec2 look;
+};
+
+/*
+ * Game state advanced in fixed SIM_TICK steps on a thread of its own, so
+ * movement doesn't depend on the frame rate and the cost of simulating is
+ * apart from rendering. Each tick publishes a snapshot and the last two
+ * are kept, the render thread blends them for the time of its frame and so
+ * shows the world one tick in the past.
+ *
+ * Headless runs call step() once per frame instead of start(), which keeps
+ * their frames reproducible.
+ */
+struct Simulation {
+    typedef std::chrono::steady_clock Clock;
+
+    // replayed instead of reading input, e.g. for --headless
+    const CameraPath* path;
+    // gets a key every tick, e.g. for --record-path, read it after stop().
+    // Set before reset(), which reserves SIM_RECORD_TICKS keys
+    CameraPath* record;
+
+    std::thread thread;
+    std::mutex mutex;  // guards everything below
+    std::condition_variable wake;
+    bool running;
+    SimState previous, current;
+    Clock::time_point current_due;  // when the tick of current was due
+    SimInput input;
+    // for the summary
+    ScopeHistory tick_history;
+    unsigned ticks, dropped;
+
+    Simulation();
+    Simulation(Simulation const&) = delete;
+    Simulation& operator=(Simulation const&) = delete;
+    ~Simulation();
+
+    // before start() or step()
+    void reset(SimState const& state);
+    void start();
+    void stop();
+    // one tick on the calling thread, without a thread running
+    void step();
+
+    // held keys replace the last ones, mouse movement adds up until a tick
+    void set_input(bool up, bool down, bool left, bool right,
+                   glm::vec2 mouse_delta);
+    // blend of the last two ticks for a frame shown at now, the last tick
+    // as it is when stepped by hand
+    SimState sample(Clock::time_point now);
+    void print_summary(std::ostream& out);
+
+   private:
+    void run();
+    // calls with mutex locked, runs the tick unlocked
+    void tick(std::unique_lock<std::mutex>& lock, Clock::time_point due);
+    SimState advance(SimState const& state, SimInput const& input) const;
+};
+
+#endif  // __SIMULATION_HPP
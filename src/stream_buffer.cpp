@@ -0,0 +1,150 @@
+#include "stream_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "frame_data.hpp"
+
+void StreamBuffer::init(GLuint prog, size_t frame_capacity) {
+    this->prog = prog;
+    // whole primitives must fit, see stream()
+    this->frame_capacity = std::max(frame_capacity, (size_t)6) / 6 * 6;
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER,
+                 this->frame_capacity * FRAMES_IN_FLIGHT *
+                     sizeof(StreamVertex),
+                 0, GL_STREAM_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(StreamVertex),
+                          (void*)offsetof(StreamVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(StreamVertex),
+                          (void*)offsetof(StreamVertex, color));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // staging never grows in frames that stay within the ring
+    triangles.reserve(this->frame_capacity);
+    lines.reserve(this->frame_capacity);
+
+    for (GLsync& fence : fences) fence = 0;
+    frame = 0;
+    used = 0;
+    draw_calls = orphans = 0;
+    streamed = 0;
+}
+
+void StreamBuffer::begin_frame() {
+    frame = (frame + 1) % FRAMES_IN_FLIGHT;
+    used = 0;
+    draw_calls = orphans = 0;
+    streamed = 0;
+
+    // only blocks if the GPU is more than FRAMES_IN_FLIGHT frames behind
+    if (fences[frame]) {
+        // a GPU this far behind may still draw from the range, give the ring
+        // new storage instead of writing over it
+        if (!wait_for_fence(fences[frame])) {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER,
+                         frame_capacity * FRAMES_IN_FLIGHT *
+                             sizeof(StreamVertex),
+                         0, GL_STREAM_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            orphans++;
+        }
+        glDeleteSync(fences[frame]);
+        fences[frame] = 0;
+    }
+}
+
+void StreamBuffer::end_frame() {
+    if (fences[frame]) glDeleteSync(fences[frame]);
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::push_triangles(const StreamVertex* verticies,
+                                  size_t count) {
+    triangles.insert(triangles.end(), verticies, verticies + count);
+}
+
+void StreamBuffer::push_lines(const StreamVertex* verticies, size_t count) {
+    lines.insert(lines.end(), verticies, verticies + count);
+}
+
+void StreamBuffer::push_line(glm::vec3 a, glm::vec3 b, uint32_t color) {
+    lines.push_back({a, color});
+    lines.push_back({b, color});
+}
+
+void StreamBuffer::flush() {
+    if (triangles.empty() && lines.empty()) return;
+
+    glUseProgram(prog);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    stream(triangles, GL_TRIANGLES, 3);
+    stream(lines, GL_LINES, 2);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StreamBuffer::stream(std::vector<StreamVertex>& staged, GLenum mode,
+                          size_t primitive_size) {
+    size_t done = 0;
+    while (done < staged.size()) {
+        size_t space = (frame_capacity - used) / primitive_size *
+                       primitive_size;
+        if (!space) {
+            // out of room for this frame, orphan the whole ring and start
+            // over, the driver hands out fresh storage without waiting
+            glBufferData(GL_ARRAY_BUFFER,
+                         frame_capacity * FRAMES_IN_FLIGHT *
+                             sizeof(StreamVertex),
+                         0, GL_STREAM_DRAW);
+            used = 0;
+            orphans++;
+            continue;
+        }
+
+        size_t count = std::min(space, staged.size() - done);
+        size_t first = frame * frame_capacity + used;
+        void* dst = glMapBufferRange(
+            GL_ARRAY_BUFFER, first * sizeof(StreamVertex),
+            count * sizeof(StreamVertex),
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                GL_MAP_INVALIDATE_RANGE_BIT);
+        if (dst) {
+            memcpy(dst, staged.data() + done, count * sizeof(StreamVertex));
+            // false if the storage was lost while mapped
+            if (!glUnmapBuffer(GL_ARRAY_BUFFER)) dst = 0;
+        }
+        // mapping failed, a plain copy still gets the verticies there
+        if (!dst)
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(StreamVertex),
+                            count * sizeof(StreamVertex),
+                            staged.data() + done);
+
+        glDrawArrays(mode, first, count);
+        draw_calls++;
+        streamed += count;
+        used += count;
+        done += count;
+    }
+    staged.clear();
+}
+
+void StreamBuffer::destroy() {
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = 0;
+    }
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+}
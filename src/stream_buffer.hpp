@@ -0,0 +1,65 @@
+#ifndef __STREAM_BUFFER_HPP
+#define __STREAM_BUFFER_HPP
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// vertex of streamed geometry, see shaders/stream.vs
+struct StreamVertex {
+    glm::vec3 position;
+    uint32_t color;  // RGBA8, red in the lowest byte
+};
+
+inline uint32_t pack_rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+    return r | g << 8 | b << 16 | (uint32_t)a << 24;
+}
+
+/*
+ * Ring of vertex memory for geometry rebuilt every frame, like debug lines
+ * or particles, so nothing has to recreate a Mesh for it. Verticies pushed
+ * during a pass are staged on the CPU and flush() appends them to the ring
+ * through an unsynchronized mapping, then draws all triangles and all lines
+ * with one call each.
+ *
+ * Every frame writes its own part of the ring, a fence per frame keeps the
+ * CPU from overwriting verticies the GPU may still read (the same scheme as
+ * FrameUniformBuffer). A frame outgrowing its part orphans the whole ring.
+ */
+struct StreamBuffer {
+    static const int FRAMES_IN_FLIGHT = 3;
+
+    GLuint prog, vao, vbo;
+    size_t frame_capacity;  // verticies per frame part of the ring
+    GLsync fences[FRAMES_IN_FLIGHT];
+    int frame;
+    size_t used;  // verticies written into the frame part so far
+    std::vector<StreamVertex> triangles, lines;  // staged until flush()
+
+    // since begin_frame()
+    unsigned draw_calls, orphans;
+    size_t streamed;  // verticies
+
+    // prog reads the attribs like shaders/stream.vs
+    void init(GLuint prog, size_t frame_capacity = 1 << 16);
+    void begin_frame();
+    void end_frame();
+    // count is a multiple of 3
+    void push_triangles(const StreamVertex* verticies, size_t count);
+    // count is a multiple of 2
+    void push_lines(const StreamVertex* verticies, size_t count);
+    void push_line(glm::vec3 a, glm::vec3 b, uint32_t color);
+    // draws and clears everything pushed, with the FrameData bound by the
+    // pass, so call it after the pass RenderQueue::flush()
+    void flush();
+    void destroy();
+
+   private:
+    void stream(std::vector<StreamVertex>& staged, GLenum mode,
+                size_t primitive_size);
+};
+
+#endif  // __STREAM_BUFFER_HPP
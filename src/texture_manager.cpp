@@ -0,0 +1,297 @@
+#include "texture_manager.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "mesh_cache.hpp"
+#include "util.hpp"
+
+TextureManager texture_manager;
+
+static float elapsed_ms(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::milli>(
+               std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+static uint32_t full_level_count(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    while (mip_size(width, levels - 1) > 1 || mip_size(height, levels - 1) > 1)
+        levels++;
+    return levels;
+}
+
+static size_t image_bytes(uint32_t width, uint32_t height,
+                          uint32_t level_count) {
+    size_t size = 0;
+    for (uint32_t level = 0; level < level_count; level++)
+        size += (size_t)4 * mip_size(width, level) * mip_size(height, level);
+    return size;
+}
+
+void build_mipmaps(TextureImage& image) {
+    image.level_count = full_level_count(image.width, image.height);
+    image.pixels.resize(
+        image_bytes(image.width, image.height, image.level_count));
+
+    size_t src = 0;
+    for (uint32_t level = 1; level < image.level_count; level++) {
+        uint32_t src_w = mip_size(image.width, level - 1);
+        uint32_t src_h = mip_size(image.height, level - 1);
+        uint32_t dst_w = mip_size(image.width, level);
+        uint32_t dst_h = mip_size(image.height, level);
+        size_t dst = src + (size_t)4 * src_w * src_h;
+
+        // 2x2 box, the last row or column of odd sizes is used twice
+        const uint8_t* in = image.pixels.data() + src;
+        uint8_t* out = image.pixels.data() + dst;
+        for (uint32_t y = 0; y < dst_h; y++) {
+            uint32_t y0 = std::min(2 * y, src_h - 1);
+            uint32_t y1 = std::min(2 * y + 1, src_h - 1);
+            for (uint32_t x = 0; x < dst_w; x++) {
+                uint32_t x0 = std::min(2 * x, src_w - 1);
+                uint32_t x1 = std::min(2 * x + 1, src_w - 1);
+                for (int c = 0; c < 4; c++) {
+                    unsigned sum = in[(y0 * src_w + x0) * 4 + c] +
+                                   in[(y0 * src_w + x1) * 4 + c] +
+                                   in[(y1 * src_w + x0) * 4 + c] +
+                                   in[(y1 * src_w + x1) * 4 + c];
+                    out[(y * dst_w + x) * 4 + c] = (sum + 2) / 4;
+                }
+            }
+        }
+        src = dst;
+    }
+}
+
+std::string texture_cache_path(const char* source_filename) {
+    return std::string(source_filename) + TEXTURE_CACHE_EXTENSION;
+}
+
+static bool read_texture_cache(const char* source_filename,
+                               SourceStamp const& stamp, TextureImage& image) {
+    FILE* f = fopen(texture_cache_path(source_filename).c_str(), "rb");
+    if (!f) return false;
+
+    TextureCacheHeader header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+              memcmp(header.magic, TEXTURE_CACHE_MAGIC, 4) == 0 &&
+              header.version == TEXTURE_CACHE_VERSION &&
+              header.source_size == stamp.size && header.width &&
+              header.height && header.width <= 0x10000 &&
+              header.height <= 0x10000 &&
+              header.level_count ==
+                  full_level_count(header.width, header.height);
+    if (ok) {
+        size_t size =
+            image_bytes(header.width, header.height, header.level_count);
+        image.pixels.resize(size);
+        ok = fread(image.pixels.data(), 1, size, f) == size &&
+             fgetc(f) == EOF;
+    }
+    fclose(f);
+
+    // touched but maybe not changed, fall back to comparing content hash
+    if (ok && header.source_mtime != stamp.mtime) {
+        ok = header.source_hash ==
+             hash_bytes(load_whole_file(source_filename));
+        if (ok)
+            update_cache_mtime(texture_cache_path(source_filename).c_str(),
+                               offsetof(TextureCacheHeader, source_mtime),
+                               stamp.mtime);
+    }
+    if (!ok) return false;
+
+    image.width = header.width;
+    image.height = header.height;
+    image.level_count = header.level_count;
+    image.decode_ms = header.decode_ms;
+    return true;
+}
+
+static bool write_texture_cache(const char* source_filename,
+                                TextureImage const& image,
+                                SourceStamp const& stamp,
+                                uint64_t source_hash) {
+    TextureCacheHeader header = {};
+    memcpy(header.magic, TEXTURE_CACHE_MAGIC, 4);
+    header.version = TEXTURE_CACHE_VERSION;
+    header.source_mtime = stamp.mtime;
+    header.source_size = stamp.size;
+    header.source_hash = source_hash;
+    header.width = image.width;
+    header.height = image.height;
+    header.level_count = image.level_count;
+    header.decode_ms = image.decode_ms;
+
+    // write to temporary file first so readers never see half written cache
+    std::string filename = texture_cache_path(source_filename);
+    std::string tmp_filename = filename + ".tmp";
+    FILE* f = fopen(tmp_filename.c_str(), "wb");
+    if (!f) {
+        std::cerr << "[WARN] Failed to write texture cache: " << filename
+                  << std::endl;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok &= fwrite(image.pixels.data(), 1, image.pixels.size(), f) ==
+          image.pixels.size();
+    ok &= fclose(f) == 0;
+
+    if (!ok || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        std::cerr << "[WARN] Failed to write texture cache: " << filename
+                  << std::endl;
+        remove(tmp_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool load_texture_image(const char* filename, TextureImage& image) {
+    auto start = std::chrono::high_resolution_clock::now();
+    SourceStamp stamp;
+    if (!get_source_stamp(filename, stamp)) return false;
+
+    if (read_texture_cache(filename, stamp, image)) {
+        image.from_cache = true;
+        image.load_ms = elapsed_ms(start);
+        return true;
+    }
+
+    std::string source = load_whole_file(filename);
+    int w, h, n;
+    stbi_uc* data = stbi_load_from_memory((const stbi_uc*)source.data(),
+                                          source.size(), &w, &h, &n, 4);
+    if (!data) return false;
+
+    image.width = w;
+    image.height = h;
+    image.pixels.assign(data, data + (size_t)w * h * 4);
+    stbi_image_free(data);
+    build_mipmaps(image);
+
+    image.from_cache = false;
+    image.decode_ms = image.load_ms = elapsed_ms(start);
+    write_texture_cache(filename, image, stamp, hash_bytes(source));
+    return true;
+}
+
+void TextureManager::init() {
+    glGenTextures(1, &palette_array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, palette_array);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, PALETTE_SIZE, 1,
+                 MAX_PALETTES, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    // colors are looked up by texel, never blended
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    palette_count = 0;
+    decoded = cache_hits = deduplicated = 0;
+    decode_ms = saved_ms = 0;
+}
+
+GLuint TextureManager::find(std::string const& path) {
+    auto it = textures.find(path);
+    if (it == textures.end()) return 0;
+    deduplicated++;
+    return it->second;
+}
+
+int TextureManager::find_palette(std::string const& key) {
+    auto it = palette_layers.find(key);
+    if (it == palette_layers.end()) return -1;
+    deduplicated++;
+    return it->second;
+}
+
+int TextureManager::add_palette(std::string const& key,
+                                const uint32_t* colors) {
+    if (palette_count == MAX_PALETTES) {
+        std::cerr << "[WARN] Out of palette layers, " << key
+                  << " uses the first one" << std::endl;
+        palette_layers[key] = 0;
+        return 0;
+    }
+
+    int layer = palette_count++;
+    palette_layers[key] = layer;
+
+    // magenta, so a palette that never arrives is easy to spot
+    uint32_t placeholder[PALETTE_SIZE];
+    if (!colors) {
+        std::fill(placeholder, placeholder + PALETTE_SIZE, 0xffff00ff);
+        colors = placeholder;
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, palette_array);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, PALETTE_SIZE, 1, 1,
+                    GL_RGBA, GL_UNSIGNED_BYTE, colors);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return layer;
+}
+
+int TextureManager::palette_for(const uint32_t* colors) {
+    std::string key =
+        "#" + std::to_string(hash_bytes(std::string_view(
+                  (const char*)colors, PALETTE_SIZE * sizeof(uint32_t))));
+    int layer = find_palette(key);
+    return layer >= 0 ? layer : add_palette(key, colors);
+}
+
+static void count_load(TextureManager& manager, TextureImage const& image) {
+    if (image.from_cache) {
+        manager.cache_hits++;
+        manager.saved_ms += std::max(image.decode_ms - image.load_ms, 0.f);
+    } else {
+        manager.decoded++;
+        manager.decode_ms += image.decode_ms;
+    }
+}
+
+void TextureManager::upload(GLuint texture, TextureImage const& image) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    const uint8_t* level_pixels = image.pixels.data();
+    for (uint32_t level = 0; level < image.level_count; level++) {
+        uint32_t w = mip_size(image.width, level);
+        uint32_t h = mip_size(image.height, level);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, w, h, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, level_pixels);
+        level_pixels += (size_t)4 * w * h;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                    image.level_count - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    count_load(*this, image);
+}
+
+bool TextureManager::upload_palette(int layer, TextureImage const& image) {
+    if (image.width != PALETTE_SIZE || image.height != 1) return false;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, palette_array);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, PALETTE_SIZE, 1, 1,
+                    GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    count_load(*this, image);
+    return true;
+}
+
+void TextureManager::print_summary(std::ostream& out) const {
+    out << "[INFO] Textures: " << decoded << " decoded in " << decode_ms
+        << " ms, " << cache_hits << " from cache saving " << saved_ms
+        << " ms, " << deduplicated << " loads deduplicated, "
+        << palette_count << " palettes in one array" << std::endl;
+}
+
+void TextureManager::destroy() {
+    for (auto& entry : textures) glDeleteTextures(1, &entry.second);
+    textures.clear();
+    palette_layers.clear();
+    glDeleteTextures(1, &palette_array);
+}
@@ -0,0 +1,98 @@
+#ifndef __TEXTURE_MANAGER_HPP
+#define __TEXTURE_MANAGER_HPP
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Binary texture file next to the source image, holding the decoded RGBA8
+ * pixels with the whole mip chain, so neither stb_image nor
+ * glGenerateMipmap run again:
+ *
+ *   TextureCacheHeader
+ *   uint8_t[4 * w * h] for every level, w and h halving down to 1
+ */
+const char TEXTURE_CACHE_MAGIC[4] = {'T', 'E', 'X', 'C'};
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+const char TEXTURE_CACHE_EXTENSION[] = ".texcache";
+
+struct TextureCacheHeader {
+    char magic[4];
+    uint32_t version;
+    // identifies the source file the cache was built from
+    int64_t source_mtime;
+    uint64_t source_size;
+    uint64_t source_hash;
+    uint32_t width, height;
+    uint32_t level_count;
+    float decode_ms;  // decoding and mipmapping the source took this long
+};
+
+// RGBA8 levels back to back, full size first
+struct TextureImage {
+    uint32_t width, height, level_count;
+    std::vector<uint8_t> pixels;
+    float decode_ms;  // of the source, now or when the cache was written
+    float load_ms;    // getting the image this time
+    bool from_cache;
+};
+
+inline uint32_t mip_size(uint32_t size, uint32_t level) {
+    return size >> level ? size >> level : 1;
+}
+
+// read from the cache of filename if that is up to date, otherwise decoded
+// and mipmapped and the cache written, safe to call from worker threads
+bool load_texture_image(const char* filename, TextureImage& image);
+// appends box filtered levels down to 1x1 to a single level image
+void build_mipmaps(TextureImage& image);
+std::string texture_cache_path(const char* source_filename);
+
+/*
+ * All textures, loaded once per path. 256x1 palettes share one
+ * GL_TEXTURE_2D_ARRAY and a mesh selects its palette with palette_layer,
+ * so voxel meshes with different palettes draw without rebinding.
+ *
+ * GL objects and the maps belong to the context thread, the file work is
+ * load_texture_image() which AssetManager runs on its workers.
+ */
+struct TextureManager {
+    static const int PALETTE_SIZE = 256;
+    static const int MAX_PALETTES = 64;
+
+    std::unordered_map<std::string, GLuint> textures;     // by path
+    std::unordered_map<std::string, int> palette_layers;  // by path or hash
+    GLuint palette_array;
+    int palette_count;
+
+    // counters for the summary
+    unsigned decoded, cache_hits, deduplicated;
+    float decode_ms, saved_ms;
+
+    void init();
+    // texture already created for path or 0, counts the hit
+    GLuint find(std::string const& path);
+    // layer of an existing palette or -1, counts the hit
+    int find_palette(std::string const& key);
+    // new layer, filled with colors or magenta until upload_palette()
+    int add_palette(std::string const& key, const uint32_t* colors = 0);
+    // layer for the 256 colors of e.g. a VOX file, shared by equal palettes
+    int palette_for(const uint32_t* colors);
+
+    // context thread, counts decode time spent or saved
+    void upload(GLuint texture, TextureImage const& image);
+    // false unless image is PALETTE_SIZE x 1
+    bool upload_palette(int layer, TextureImage const& image);
+    void print_summary(std::ostream& out) const;
+    void destroy();
+};
+
+extern TextureManager texture_manager;
+
+#endif  // __TEXTURE_MANAGER_HPP
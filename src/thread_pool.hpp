@@ -0,0 +1,50 @@
+#ifndef __THREAD_POOL_HPP
+#define __THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads running jobs in submission order
+struct ThreadPool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    // 0 starts one worker less than there are cores, the caller keeps one
+    explicit ThreadPool(unsigned threads = 0);
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+    ~ThreadPool();
+
+    template <typename F>
+    auto submit(F job) -> std::future<decltype(job())> {
+        using Result = decltype(job());
+        // std::function needs a copyable target, packaged_task is move only
+        auto task =
+            std::make_shared<std::packaged_task<Result()>>(std::move(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back([task] { (*task)(); });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+    size_t size() const { return workers.size(); }
+    // drops jobs not started yet and joins the workers
+    void shutdown();
+
+   private:
+    void run();
+};
+
+#endif  // __THREAD_POOL_HPP
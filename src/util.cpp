@@ -2,72 +2,11 @@
 
 #include <stb_image.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
-#include <sstream>
 #include <vector>
 
-GLuint create_shader_program(std::string const& vert_src,
-                             std::string const& frag_src) {
-    return create_shader_program(vert_src.c_str(), frag_src.c_str());
-}
-
-GLuint create_shader_program(const char* vert_src, const char* frag_src) {
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    GLint res = GL_FALSE;
-
-    int log_size = 0;
-
-    // compile vertex shader
-    glShaderSource(vs, 1, &vert_src, 0);
-    glCompileShader(vs);
-
-    // check vertex shader
-    glGetShaderiv(vs, GL_COMPILE_STATUS, &res);
-    glGetShaderiv(vs, GL_INFO_LOG_LENGTH, &log_size);
-    if (log_size > 1) {
-        std::vector<char> errmsg(log_size + 1, 0);
-        glGetShaderInfoLog(vs, log_size, 0, errmsg.data());
-        std::cout << vert_src << ":" << std::endl;
-        std::cout << errmsg.data() << std::endl;
-    }
-
-    // compile fragment shader
-    glShaderSource(fs, 1, &frag_src, 0);
-    glCompileShader(fs);
-
-    // check fragment shader
-    glGetShaderiv(fs, GL_COMPILE_STATUS, &res);
-    glGetShaderiv(fs, GL_INFO_LOG_LENGTH, &log_size);
-    if (log_size > 1) {
-        std::vector<char> errmsg(log_size + 1, 0);
-        glGetShaderInfoLog(fs, log_size, 0, errmsg.data());
-        std::cout << frag_src << ":" << std::endl;
-        std::cout << errmsg.data() << std::endl;
-    }
-
-    // create and link program
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, vs);
-    glAttachShader(prog, fs);
-    glLinkProgram(prog);
-
-    // check program
-    glGetProgramiv(prog, GL_LINK_STATUS, &res);
-    glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &log_size);
-    if (log_size > 1) {
-        std::vector<char> errmsg(log_size + 1, 0);
-        glGetProgramInfoLog(prog, log_size, 0, errmsg.data());
-        std::cout << errmsg.data() << std::endl;
-    }
-
-    glDeleteShader(vs);
-    glDeleteShader(fs);
-
-    return prog;
-}
-
 void print_mat4(glm::mat4 const& m) {
     for (int y = 0; y < 4; y++) {
         for (int x = 0; x < 4; x++) {
@@ -85,24 +24,46 @@ void print_vec4(glm::vec4 const& v) {
 }
 
 std::string load_whole_file(const char* filename) {
-    std::ifstream is(filename);
+    std::ifstream is(filename, std::ios::binary);
+    if (!is) {
+        std::cerr << "[ERROR] Failed to open file: " << filename << std::endl;
+        return std::string();
+    }
 
     is.seekg(0, is.end);
     size_t len = is.tellg();
     is.seekg(0, is.beg);
 
-    char buffer[len + 1];
-    for (size_t i = 0; i < len + 1; i++) buffer[i] = 0;
-
-    is.read(buffer, len);
+    std::string buffer(len, '\0');
+    is.read(buffer.data(), len);
     is.close();
 
-    return std::string(buffer);
+    return buffer;
+}
+
+uint64_t hash_bytes(std::string_view data) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+void append_quad(MeshData& mesh, const Vertex quad[4]) {
+    uint32_t base = mesh.verticies.size();
+    mesh.verticies.insert(mesh.verticies.end(), quad, quad + 4);
+    for (uint32_t i : {0, 1, 3, 1, 2, 3}) mesh.indicies.push_back(base + i);
 }
 
-std::vector<Vertex> quad_of_four_verticies(std::vector<Vertex>& vs) {
-    assert(vs.size() == 4);
-    return {vs[0], vs[1], vs[3], vs[1], vs[2], vs[3]};
+GLuint create_texture_rgba(const void* pixels, int w, int h) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 pixels);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    return texture;
 }
 
 GLuint load_texture_file(const char* filename) {
@@ -111,17 +72,10 @@ GLuint load_texture_file(const char* filename) {
     if (!data) {
         std::cerr << "[ERROR] Failed to load texture: " << filename
                   << std::endl;
+        return 0;
     }
 
-    GLenum tex_format = GL_RGBA;
-    if (n == 3) tex_format = GL_RGB;
-
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                 data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    GLuint texture = create_texture_rgba(data, x, y);
 
     stbi_image_free(data);
 
@@ -131,98 +85,76 @@ GLuint load_texture_file(const char* filename) {
     return texture;
 }
 
-/*
- * Supports only:
- *  - 3d positions
- *  - 3d normals
- *  - 2d texture coords
- *  - triangular faces
- */
-std::vector<Vertex> parse_obj_format(std::string const& input) {
-    std::stringstream iss(input);
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec2> texcoords;
-    std::vector<Vertex> output;
-    int ln = 0;
-    while (!iss.eof()) {  // parse line by line until eof
-        ln++;
-        std::string line;
-        std::getline(iss, line);
-        if (line.size() == 0 || line[0] == '#')  // comment or empty line
-            continue;
-
-        std::stringstream lss(line);
-        std::string command;
-        lss >> command;
-        if (command.size() == 0) continue;  // empty line
-
-        if (command == "v") {
-            glm::vec3 v;
-            lss >> v.x >> v.y >> v.z;
-            positions.push_back(v);
-        } else if (command == "vn") {
-            glm::vec3 n;
-            lss >> n.x >> n.y >> n.z;
-            normals.push_back(n);
-        } else if (command == "vt") {
-            glm::vec2 tc;
-            lss >> tc.x >> tc.y;
-            texcoords.push_back(tc);
-        } else if (command == "f") {
-            for (int i = 0; i < 3; i++) {
-                std::string vertex_index;
-                std::vector<int> indicies;
-                lss >> vertex_index;
-                {
-                    int acc = 0;
-                    int sig = 1;
-                    for (int j = 0; j <= vertex_index.size(); j++) {
-                        if (j == vertex_index.size() ||
-                            vertex_index[j] == '/') {
-                            indicies.push_back(acc * sig);
-                            acc = 0;
-                            sig = 1;
-                        } else if (vertex_index[j] == '-') {
-                            sig *= -1;
-                        } else if (std::isdigit(vertex_index[j])) {
-                            acc = acc * 10 + (vertex_index[j] - '0');
-                        } else {
-                            std::cerr << "[WARN] Unsupported character in "
-                                         "vertex index: "
-                                      << vertex_index[j] << std::endl;
-                        }
-                    }
-                }
-
-                if (indicies.size() == 0) {
-                    std::cerr << "[ERROR] Invalid vertex index format in face "
-                                 "definition in OBJ file on line: "
-                              << ln << std::endl;
-                    exit(1);
-                }
-
-                int pi, ti, ni;
-                pi = indicies[0];
-                ti = (indicies.size() > 1) ? indicies[1] : 0;
-                ni = (indicies.size() > 2) ? indicies[2] : 0;
-
-                Vertex result;
-                if (pi > 0) result.position = positions[pi - 1];
-                if (pi < 0) result.position = positions[positions.size() + pi];
-                if (ti > 0) result.texture_coord = texcoords[ti - 1];
-                if (ti < 0)
-                    result.texture_coord = texcoords[texcoords.size() + ti];
-                if (ni > 0) result.normal = normals[ni - 1];
-                if (ni < 0) result.normal = normals[normals.size() + ni];
-
-                output.push_back(result);
-            }
-        } else {
-            std::cerr << "[WARN] OBJ parser does not support: " << line
-                      << std::endl;
+static uint32_t png_crc(const uint8_t* data, size_t size, uint32_t crc) {
+    static uint32_t table[256];
+    if (!table[1]) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
         }
     }
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+static void put_be32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back(v >> shift);
+}
+
+static void put_png_chunk(std::ofstream& file, const char* type,
+                          std::vector<uint8_t> const& data) {
+    std::vector<uint8_t> chunk;
+    put_be32(chunk, data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    uint32_t crc = ~png_crc(chunk.data() + 4, chunk.size() - 4, ~0u);
+    put_be32(chunk, crc);
+    file.write((const char*)chunk.data(), chunk.size());
+}
+
+bool write_png_file(const char* filename, const uint8_t* rgba, int w, int h) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "[ERROR] Failed to write image: " << filename
+                  << std::endl;
+        return false;
+    }
+    file.write("\x89PNG\r\n\x1a\n", 8);
+
+    std::vector<uint8_t> header;
+    put_be32(header, w);
+    put_be32(header, h);
+    header.insert(header.end(), {8, 6, 0, 0, 0});  // 8 bit RGBA
+    put_png_chunk(file, "IHDR", header);
+
+    // rows prefixed with filter 0, zlib stream of stored deflate blocks
+    size_t row_size = (size_t)w * 4;
+    std::vector<uint8_t> raw;
+    raw.reserve((row_size + 1) * h);
+    for (int y = 0; y < h; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba + y * row_size, rgba + (y + 1) * row_size);
+    }
+
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    for (size_t pos = 0; pos < raw.size() || pos == 0; pos += 0xffff) {
+        uint16_t len = std::min<size_t>(0xffff, raw.size() - pos);
+        zlib.push_back(pos + len == raw.size());  // last block flag
+        zlib.insert(zlib.end(), {(uint8_t)len, (uint8_t)(len >> 8),
+                                 (uint8_t)~len, (uint8_t)(~len >> 8)});
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+    }
+    uint32_t a = 1, b = 0;  // adler32
+    for (uint8_t byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_be32(zlib, b << 16 | a);
+    put_png_chunk(file, "IDAT", zlib);
+    put_png_chunk(file, "IEND", {});
 
-    return output;
+    return (bool)file;
 }
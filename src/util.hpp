@@ -5,19 +5,24 @@
 
 #include <glm/glm.hpp>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "vertex.hpp"
 
-GLuint create_shader_program(const char* vert_src, const char* frag_src);
-GLuint create_shader_program(std::string const& vert_src,
-                             std::string const& frag_src);
 void print_mat4(glm::mat4 const& m);
 void print_vec4(glm::vec4 const& v);
 std::string load_whole_file(const char* filename);
-std::vector<Vertex> quad_of_four_verticies(std::vector<Vertex>& vs);
+// FNV-1a, for cache keys
+uint64_t hash_bytes(std::string_view data);
+// corners in order, as two triangles 0 1 3 and 1 2 3
+void append_quad(MeshData& mesh, const Vertex quad[4]);
 
+GLuint create_texture_rgba(const void* pixels, int w, int h);
+// synchronous and uncached, 0 if the file can't be decoded, see
+// TextureManager for the cached path
 GLuint load_texture_file(const char* filename);
-std::vector<Vertex> parse_obj_format(std::string const& input);
+// uncompressed 8 bit RGBA PNG, rows top to bottom
+bool write_png_file(const char* filename, const uint8_t* rgba, int w, int h);
 
 #endif  // __UTIL_HPP
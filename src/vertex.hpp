@@ -1,13 +1,32 @@
 #ifndef __VERTEX_HPP
 #define __VERTEX_HPP
 
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <vector>
+
 struct Vertex {
     glm::vec3 position;
     glm::vec2 texture_coord;
     glm::vec3 normal;
 };
 
+// 8 bytes instead of 32 for voxel meshes, see pack_voxel_verticies()
+struct PackedVertex {
+    int16_t position[3];  // in steps of Mesh::position_step
+    uint8_t normal;       // index into PACKED_NORMALS
+    uint8_t color;        // texel of the 256x1 palette, u = (color + 0.5) / 256
+};
+
+const glm::vec3 PACKED_NORMALS[6] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                                     {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+
+// indexed triangle list, 3 indicies per triangle
+struct MeshData {
+    std::vector<Vertex> verticies;
+    std::vector<uint32_t> indicies;
+};
+
 #endif // __VERTEX_HPP
 
 
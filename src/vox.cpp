@@ -0,0 +1,168 @@
+#include "vox.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "arena.hpp"
+
+namespace {
+
+// largest model side MagicaVoxel writes
+const uint32_t VOX_MAX_SIZE = 256;
+
+struct VoxChunk {
+    char id[4];
+    uint32_t content_size, children_size;
+};
+
+inline uint32_t read_u32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+}  // namespace
+
+/*
+ * Supports only first model in the file and chunks:
+ *  - SIZE
+ *  - XYZI
+ *  - RGBA
+ */
+bool parse_vox_format(std::string_view input, VoxModel& model) {
+    const char* p = input.data();
+    const char* end = input.data() + input.size();
+
+    model.size = {0, 0, 0};
+    model.voxels.clear();
+    model.has_palette = false;
+
+    if (input.size() < 8 || memcmp(p, "VOX ", 4) != 0) {
+        std::cerr << "[ERROR] Not a VOX file" << std::endl;
+        return false;
+    }
+    p += 8;  // magic and version
+
+    bool has_size = false, has_voxels = false;
+    while (p + sizeof(VoxChunk) <= end) {
+        VoxChunk chunk;
+        memcpy(chunk.id, p, 4);
+        chunk.content_size = read_u32(p + 4);
+        chunk.children_size = read_u32(p + 8);
+        const char* content = p + sizeof(VoxChunk);
+
+        // sizes are compared as integers, pointers past end are undefined
+        if (chunk.content_size > (size_t)(end - content)) {
+            std::cerr << "[ERROR] Truncated chunk in VOX file" << std::endl;
+            return false;
+        }
+
+        std::string_view id(chunk.id, 4);
+        if (id == "MAIN") {
+            p = content + chunk.content_size;  // step into children
+            continue;
+        } else if (id == "SIZE" && !has_size) {
+            if (chunk.content_size < 12) return false;
+            uint32_t x = read_u32(content), y = read_u32(content + 4),
+                     z = read_u32(content + 8);
+            if (!x || !y || !z || x > VOX_MAX_SIZE || y > VOX_MAX_SIZE ||
+                z > VOX_MAX_SIZE) {
+                std::cerr << "[ERROR] Invalid SIZE chunk in VOX file"
+                          << std::endl;
+                return false;
+            }
+            model.size = {(int)x, (int)y, (int)z};
+            model.voxels.assign(model.size.x * model.size.y * model.size.z, 0);
+            has_size = true;
+        } else if (id == "XYZI" && has_size && !has_voxels) {
+            uint32_t count =
+                chunk.content_size >= 4 ? read_u32(content) : 0;
+            if (chunk.content_size < 4 ||
+                (uint64_t)count * 4 + 4 > chunk.content_size) {
+                std::cerr << "[ERROR] Invalid XYZI chunk in VOX file"
+                          << std::endl;
+                return false;
+            }
+            const uint8_t* v = (const uint8_t*)content + 4;
+            for (uint32_t i = 0; i < count; i++, v += 4) {
+                if (v[0] >= model.size.x || v[1] >= model.size.y ||
+                    v[2] >= model.size.z)
+                    continue;
+                int index = v[0] + model.size.x * (v[1] + model.size.y * v[2]);
+                model.voxels[index] = v[3];
+            }
+            has_voxels = true;
+        } else if (id == "RGBA" &&
+                   chunk.content_size >= sizeof(model.palette)) {
+            memcpy(model.palette, content, sizeof(model.palette));
+            model.has_palette = true;
+        } else if (id == "SIZE" || id == "XYZI") {
+            std::cerr << "[WARN] VOX parser supports only the first model"
+                      << std::endl;
+        }
+
+        uint64_t skip = (uint64_t)chunk.content_size + chunk.children_size;
+        if (skip > (uint64_t)(end - content)) break;  // children cut off
+        p = content + skip;
+    }
+
+    if (!has_voxels) {
+        std::cerr << "[ERROR] VOX file has no voxel data" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Merges coplanar faces of the same color into maximal rectangles.
+ *
+ * Output follows the MagicaVoxel OBJ export: y is up, model is centered on
+ * floor(size / 2) in the horizontal plane and texture coords point into the
+ * 256x1 palette texture. Scene transforms (nTRN) are not applied.
+ */
+MeshData greedy_mesh_voxels(VoxModel const& model, float scale) {
+    glm::ivec3 size = model.size;
+    glm::vec3 pivot = {(float)(size.x / 2), (float)(size.y / 2), 0.0f};
+    // MagicaVoxel (x, y, z) maps to (-y, z, -x)
+    auto rotate = [](glm::vec3 v) { return glm::vec3{-v.y, v.z, -v.x}; };
+
+    MeshData output;
+    greedy_mesh_region(
+        [&](int x, int y, int z) { return model.at(x, y, z); },
+        glm::ivec3(0), size, pivot, rotate, scale, output);
+    return output;
+}
+
+bool pack_voxel_verticies(const Vertex* verticies, size_t count, float step,
+                          PackedVertex* packed) {
+    const float EPSILON = 1e-3f;  // of a grid step or palette texel
+    bool exact = true;
+    for (size_t i = 0; i < count; i++) {
+        Vertex const& v = verticies[i];
+        PackedVertex& p = packed[i];
+
+        for (int k = 0; k < 3; k++) {
+            float grid = v.position[k] / step;
+            float q = std::min(std::max(std::round(grid), -32768.f), 32767.f);
+            exact &= std::fabs(grid - q) < EPSILON;
+            p.position[k] = (int16_t)q;
+        }
+
+        float best = -2;
+        for (int n = 0; n < 6; n++) {
+            float d = glm::dot(v.normal, PACKED_NORMALS[n]);
+            if (d > best) best = d, p.normal = n;
+        }
+        exact &= best > 1 - EPSILON;
+
+        float texel = v.texture_coord.x * 256 - 0.5f;
+        float color = std::min(std::max(std::round(texel), 0.f), 255.f);
+        exact &= std::fabs(texel - color) < EPSILON &&
+                 std::fabs(v.texture_coord.y - 0.5f) < EPSILON;
+        p.color = (uint8_t)color;
+    }
+    return exact;
+}
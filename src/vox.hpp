@@ -0,0 +1,140 @@
+#ifndef __VOX_HPP
+#define __VOX_HPP
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string_view>
+#include <vector>
+
+#include "arena.hpp"
+#include "vertex.hpp"
+
+// scale used by MagicaVoxel OBJ export, one voxel is 0.1 units
+const float VOX_SCALE = 0.1f;
+
+struct VoxModel {
+    glm::ivec3 size;              // in MagicaVoxel space, z is up
+    std::vector<uint8_t> voxels;  // color index per cell, 0 means empty
+    uint32_t palette[256];        // RGBA chunk, texel i is color index i + 1
+    bool has_palette;
+
+    uint8_t at(int x, int y, int z) const {
+        if (x < 0 || y < 0 || z < 0 || x >= size.x || y >= size.y ||
+            z >= size.z)
+            return 0;
+        return voxels[x + size.x * (y + size.y * z)];
+    }
+};
+
+bool parse_vox_format(std::string_view input, VoxModel& model);
+MeshData greedy_mesh_voxels(VoxModel const& model, float scale = VOX_SCALE);
+
+/*
+ * Greedy meshes the faces of solid cells in [begin, end), at(x, y, z) gives
+ * the color of any cell including those just outside the region, so faces
+ * towards a neighbour are culled against it. Corners are placed at
+ * rotate((cell - pivot) * scale), rotate must keep handedness.
+ */
+template <typename At, typename Rotate>
+void greedy_mesh_region(At const& at, glm::ivec3 begin, glm::ivec3 end,
+                        glm::vec3 pivot, Rotate const& rotate, float scale,
+                        MeshData& output) {
+    glm::ivec3 size = end - begin;
+    ArenaScope scratch(load_arena);
+    LoadVector<int> mask;
+    for (int d = 0; d < 3; d++) {
+        int u = (d + 1) % 3;
+        int v = (d + 2) % 3;
+        mask.assign(size[u] * size[v], 0);
+
+        glm::ivec3 x = begin;
+        glm::ivec3 q = {0, 0, 0};
+        q[d] = 1;
+
+        // plane k lies between cells k - 1 and k along axis d, a face in the
+        // mask is its color, signed by direction, 0 means no face
+        for (x[d] = begin[d]; x[d] <= end[d]; x[d]++) {
+            bool a_inside = x[d] > begin[d], b_inside = x[d] < end[d];
+            int n = 0;
+            for (x[v] = begin[v]; x[v] < end[v]; x[v]++) {
+                for (x[u] = begin[u]; x[u] < end[u]; x[u]++) {
+                    uint8_t a = at(x.x - q.x, x.y - q.y, x.z - q.z);
+                    uint8_t b = at(x.x, x.y, x.z);
+                    int c = 0;
+                    if (a && !b && a_inside) c = a;
+                    if (b && !a && b_inside) c = -(int)b;
+                    mask[n++] = c;
+                }
+            }
+
+            n = 0;
+            for (int j = 0; j < size[v]; j++) {
+                for (int i = 0; i < size[u];) {
+                    int c = mask[n];
+                    if (!c) {
+                        i++;
+                        n++;
+                        continue;
+                    }
+
+                    int w = 1;
+                    while (i + w < size[u] && mask[n + w] == c) w++;
+
+                    int h = 1;
+                    for (; j + h < size[v]; h++) {
+                        bool row_ok = true;
+                        for (int k = 0; k < w; k++) {
+                            if (mask[n + k + h * size[u]] != c) {
+                                row_ok = false;
+                                break;
+                            }
+                        }
+                        if (!row_ok) break;
+                    }
+
+                    glm::vec3 origin(0), du(0), dv(0), normal(0);
+                    origin[d] = x[d];
+                    origin[u] = begin[u] + i;
+                    origin[v] = begin[v] + j;
+                    du[u] = w;
+                    dv[v] = h;
+                    normal[d] = c > 0 ? 1 : -1;
+
+                    glm::vec2 uv = {((c > 0 ? c : -c) - 0.5f) / 256, 0.5f};
+                    glm::vec3 world_normal = rotate(normal);
+
+                    uint32_t base = output.verticies.size();
+                    glm::vec3 corners[4] = {origin, origin + du,
+                                            origin + du + dv, origin + dv};
+                    for (glm::vec3 corner : corners)
+                        output.verticies.push_back(
+                            {rotate((corner - pivot) * scale), uv,
+                             world_normal});
+
+                    // (u, v, d) is right-handed, flip winding for -d faces
+                    if (c > 0) {
+                        for (uint32_t k : {0, 1, 2, 0, 2, 3})
+                            output.indicies.push_back(base + k);
+                    } else {
+                        for (uint32_t k : {0, 2, 1, 0, 3, 2})
+                            output.indicies.push_back(base + k);
+                    }
+
+                    for (int l = 0; l < h; l++)
+                        for (int k = 0; k < w; k++)
+                            mask[n + k + l * size[u]] = 0;
+
+                    i += w;
+                    n += w;
+                }
+            }
+        }
+    }
+}
+// always fills count packed verticies, returns false if anything was rounded
+// off, i.e. positions are off the grid of step or out of int16 range, normals
+// are not axis aligned or texture coords don't hit a palette texel center
+bool pack_voxel_verticies(const Vertex* verticies, size_t count, float step,
+                          PackedVertex* packed);
+
+#endif  // __VOX_HPP
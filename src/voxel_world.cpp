@@ -0,0 +1,175 @@
+#include "voxel_world.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "vox.hpp"
+
+namespace {
+
+const int CHUNK_MASK = CHUNK_SIZE - 1;
+
+inline int cell_index(int x, int y, int z) {
+    return x + CHUNK_SIZE * (y + CHUNK_SIZE * z);
+}
+
+inline int padded_index(int x, int y, int z) {
+    return (x + 1) + CHUNK_PADDED * ((y + 1) + CHUNK_PADDED * (z + 1));
+}
+
+}  // namespace
+
+uint64_t VoxelWorld::key(glm::ivec3 coord) {
+    // 21 bits per axis, plenty of chunks either way of the origin
+    const uint64_t MASK = (1 << 21) - 1;
+    return ((uint64_t)coord.x & MASK) | ((uint64_t)coord.y & MASK) << 21 |
+           ((uint64_t)coord.z & MASK) << 42;
+}
+
+VoxelChunk* VoxelWorld::find(glm::ivec3 coord) const {
+    return find(key(coord));
+}
+
+VoxelChunk* VoxelWorld::find(uint64_t key) const {
+    auto it = chunks.find(key);
+    return it == chunks.end() ? 0 : it->second.get();
+}
+
+uint8_t VoxelWorld::get(glm::ivec3 cell) const {
+    VoxelChunk* chunk = find(chunk_of(cell));
+    if (!chunk) return 0;
+    return chunk->cells[cell_index(cell.x & CHUNK_MASK, cell.y & CHUNK_MASK,
+                                   cell.z & CHUNK_MASK)];
+}
+
+void VoxelWorld::set(glm::ivec3 cell, uint8_t color) {
+    glm::ivec3 coord = chunk_of(cell);
+    uint64_t chunk_key = key(coord);
+    VoxelChunk* chunk = find(chunk_key);
+    if (!chunk) {
+        if (!color) return;  // empty stays unallocated
+        chunk = new VoxelChunk;
+        chunk->coord = coord;
+        memset(chunk->cells, 0, sizeof(chunk->cells));
+        chunk->dirty = false;
+        chunks[chunk_key].reset(chunk);
+    }
+
+    glm::ivec3 local = {cell.x & CHUNK_MASK, cell.y & CHUNK_MASK,
+                        cell.z & CHUNK_MASK};
+    uint8_t& value = chunk->cells[cell_index(local.x, local.y, local.z)];
+    if (value == color) return;
+    value = color;
+    mark_dirty(chunk);
+
+    // the neighbour culls its faces against this cell
+    for (int d = 0; d < 3; d++) {
+        glm::ivec3 step = {0, 0, 0};
+        if (local[d] == 0) step[d] = -1;
+        if (local[d] == CHUNK_MASK) step[d] = 1;
+        if (step[d])
+            if (VoxelChunk* neighbour = find(coord + step))
+                mark_dirty(neighbour);
+    }
+}
+
+void VoxelWorld::mark_dirty(VoxelChunk* chunk) {
+    if (chunk->dirty) return;
+    chunk->dirty = true;
+    dirty.push_back(key(chunk->coord));
+}
+
+void VoxelWorld::fill_sphere(glm::vec3 center, float radius,
+                             uint8_t color) {
+    glm::vec3 c = center / voxel_size;
+    float r = radius / voxel_size;
+    glm::ivec3 lo = {(int)std::floor(c.x - r), (int)std::floor(c.y - r),
+                     (int)std::floor(c.z - r)};
+    glm::ivec3 hi = {(int)std::ceil(c.x + r), (int)std::ceil(c.y + r),
+                     (int)std::ceil(c.z + r)};
+
+    glm::ivec3 cell;
+    for (cell.z = lo.z; cell.z <= hi.z; cell.z++)
+        for (cell.y = lo.y; cell.y <= hi.y; cell.y++)
+            for (cell.x = lo.x; cell.x <= hi.x; cell.x++) {
+                glm::vec3 d = glm::vec3(cell.x + 0.5f, cell.y + 0.5f,
+                                        cell.z + 0.5f) -
+                              c;
+                if (glm::dot(d, d) <= r * r) set(cell, color);
+            }
+}
+
+void VoxelWorld::generate_terrain(glm::ivec3 min, glm::ivec3 max) {
+    int depth = max.y - min.y;
+    glm::ivec3 cell;
+    for (cell.z = min.z; cell.z < max.z; cell.z++)
+        for (cell.x = min.x; cell.x < max.x; cell.x++) {
+            float hills = std::sin(cell.x * 0.07f) * std::cos(cell.z * 0.05f) +
+                          0.5f * std::sin((cell.x + cell.z) * 0.11f);
+            int height = min.y + (int)(depth * (0.55f + 0.25f * hills));
+            for (cell.y = min.y; cell.y < std::min(height, max.y); cell.y++) {
+                // palette bands from the bottom up, grass on top
+                uint8_t color = cell.y == height - 1
+                                    ? 20
+                                    : 40 + 8 * ((cell.y - min.y) * 4 / depth);
+                set(cell, color);
+            }
+        }
+}
+
+bool VoxelWorld::raycast(glm::vec3 from, glm::vec3 dir, float max_distance,
+                         glm::vec3& hit) const {
+    float step = voxel_size / 2;
+    for (float t = 0; t <= max_distance; t += step) {
+        glm::vec3 p = (from + dir * t) / voxel_size;
+        glm::ivec3 cell = {(int)std::floor(p.x), (int)std::floor(p.y),
+                           (int)std::floor(p.z)};
+        if (get(cell)) {
+            hit = from + dir * t;
+            return true;
+        }
+    }
+    return false;
+}
+
+void VoxelWorld::copy_padded(VoxelChunk const& chunk, uint8_t* padded) const {
+    memset(padded, 0, CHUNK_PADDED * CHUNK_PADDED * CHUNK_PADDED);
+    for (int z = 0; z < CHUNK_SIZE; z++)
+        for (int y = 0; y < CHUNK_SIZE; y++)
+            memcpy(padded + padded_index(0, y, z),
+                   chunk.cells + cell_index(0, y, z), CHUNK_SIZE);
+
+    // only face neighbours matter, edges and corners are never sampled
+    for (int d = 0; d < 3; d++) {
+        int u = (d + 1) % 3, v = (d + 2) % 3;
+        for (int side : {-1, 1}) {
+            glm::ivec3 step = {0, 0, 0};
+            step[d] = side;
+            VoxelChunk* neighbour = find(chunk.coord + step);
+            if (!neighbour) continue;
+
+            glm::ivec3 src, dst;
+            src[d] = side < 0 ? CHUNK_MASK : 0;
+            dst[d] = side < 0 ? -1 : CHUNK_SIZE;
+            for (int j = 0; j < CHUNK_SIZE; j++)
+                for (int i = 0; i < CHUNK_SIZE; i++) {
+                    src[u] = dst[u] = i;
+                    src[v] = dst[v] = j;
+                    padded[padded_index(dst.x, dst.y, dst.z)] =
+                        neighbour->cells[cell_index(src.x, src.y, src.z)];
+                }
+        }
+    }
+}
+
+MeshData mesh_chunk(const uint8_t* padded, float voxel_size) {
+    MeshData output;
+    greedy_mesh_region(
+        [padded](int x, int y, int z) {
+            return padded[padded_index(x, y, z)];
+        },
+        glm::ivec3(0), glm::ivec3(CHUNK_SIZE), glm::vec3(0),
+        [](glm::vec3 v) { return v; }, voxel_size, output);
+    return output;
+}
@@ -0,0 +1,68 @@
+#ifndef __VOXEL_WORLD_HPP
+#define __VOXEL_WORLD_HPP
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "vertex.hpp"
+
+const int CHUNK_SIZE = 32;  // cells per side, a power of two
+const int CHUNK_SHIFT = 5;
+// a chunk with one cell of its face neighbours on every side
+const int CHUNK_PADDED = CHUNK_SIZE + 2;
+
+struct VoxelChunk {
+    glm::ivec3 coord;  // in chunks
+    uint8_t cells[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];  // x fastest, 0 empty
+    bool dirty;  // queued for remeshing
+};
+
+/*
+ * Editable voxel terrain in chunks of CHUNK_SIZE cubed cells, allocated on
+ * first solid write. Cells use the palette color indicies of VoxModel, but
+ * y is up. Edits mark the chunk and the face neighbours sharing the edited
+ * cell's faces dirty, whoever meshes the world takes them from dirty.
+ */
+struct VoxelWorld {
+    float voxel_size;  // cell edge in world units
+    std::unordered_map<uint64_t, std::unique_ptr<VoxelChunk>> chunks;
+    std::vector<uint64_t> dirty;  // chunk keys, each at most once
+
+    explicit VoxelWorld(float voxel_size = 0.25f) : voxel_size(voxel_size) {}
+
+    static uint64_t key(glm::ivec3 coord);
+    static glm::ivec3 chunk_of(glm::ivec3 cell) {
+        return {cell.x >> CHUNK_SHIFT, cell.y >> CHUNK_SHIFT,
+                cell.z >> CHUNK_SHIFT};
+    }
+
+    VoxelChunk* find(glm::ivec3 coord) const;
+    VoxelChunk* find(uint64_t key) const;
+    uint8_t get(glm::ivec3 cell) const;
+    void set(glm::ivec3 cell, uint8_t color);
+    // sets every cell whose center is inside the sphere, in world units
+    void fill_sphere(glm::vec3 center, float radius, uint8_t color);
+    // heightmap of rolling hills over cells [min, max), colored by height
+    void generate_terrain(glm::ivec3 min, glm::ivec3 max);
+    // marches along dir in half cell steps, hit is the first solid sample
+    bool raycast(glm::vec3 from, glm::vec3 dir, float max_distance,
+                 glm::vec3& hit) const;
+
+    // cells of the chunk and the border cells of its face neighbours, in
+    // CHUNK_PADDED cubed cells, x fastest
+    void copy_padded(VoxelChunk const& chunk, uint8_t* padded) const;
+    glm::vec3 chunk_origin(glm::ivec3 coord) const {
+        return glm::vec3(coord.x, coord.y, coord.z) * (CHUNK_SIZE * voxel_size);
+    }
+
+   private:
+    void mark_dirty(VoxelChunk* chunk);
+};
+
+// greedy meshes padded cells of a chunk, relative to the chunk corner
+MeshData mesh_chunk(const uint8_t* padded, float voxel_size);
+
+#endif  // __VOXEL_WORLD_HPP
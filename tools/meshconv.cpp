@@ -0,0 +1,53 @@
+/*
+ * Converts OBJ files into binary mesh caches next to them.
+ *
+ * usage: meshconv file.obj...
+ *
+ * Produces file.obj.meshcache with all levels of detail, which
+ * Mesh::create_from_obj picks up as long as the source file stays the same.
+ */
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../src/lod.hpp"
+#include "../src/mesh_cache.hpp"
+#include "../src/obj.hpp"
+#include "../src/util.hpp"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " file.obj..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        SourceStamp stamp;
+        if (!get_source_stamp(argv[i], stamp)) {
+            std::cerr << "[ERROR] Failed to open file: " << argv[i]
+                      << std::endl;
+            ok = false;
+            continue;
+        }
+
+        std::string source = load_whole_file(argv[i]);
+        std::vector<MeshLod> lods;
+        MeshData mesh =
+            merge_lods(build_mesh_lods(parse_obj_format_indexed(source)), lods);
+        std::string output = mesh_cache_path(argv[i]);
+
+        if (!write_mesh_cache(output.c_str(), mesh, stamp, hash_bytes(source),
+                              lods)) {
+            ok = false;
+            continue;
+        }
+
+        std::cout << argv[i] << " -> " << output << " ("
+                  << mesh.verticies.size() << " verticies, "
+                  << mesh.indicies.size() << " indicies, " << lods.size()
+                  << " levels of detail)" << std::endl;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}